@@ -6,649 +6,8663 @@
 // STL includes
 #include <algorithm> // includes functions to create heap and perform push, pop and sort operations
 #include <vector>
+#include <list>
+#include <unordered_map>
 #include <cfloat>
+#include <limits>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+
+// SIMD includes, the AVX2 heuristic kernels are only built when the compiler targets AVX2 (-mavx2 or -march=native)
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// POSIX includes, for mapping graph files
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
 // A* Algorithm Code Starts -----------------------------------------------------------------------------------------------------------
 
-template <class UserState> class AStarSearch // The A* search class. UserState is used to retrieve data of a particular state.
+// State index policies. The search uses the index to find the live node holding a state, so it can tell whether a
+// successor is already on the open or closed list without scanning them.
+
+template <class Node> class AStarLinearIndex // No index at all, the search falls back to a linear scan of both lists using IsSameState
+{
+public:
+
+	enum { IsIndexed = 0 };
+
+	template <class UserState> Node *Find( UserState & ) { return NULL; }
+	void Insert( Node * ) {}
+	void Erase( Node * ) {}
+	void Clear() {}
+	size_t MemoryUsage() const { return 0; }
+};
+
+template <class Node> class AStarHashIndex // Hash table keyed by UserState::Hash(). States that are IsSameState must return the same Hash()
+{
+public:
+
+	enum { IsIndexed = 1 };
+
+	AStarHashIndex() :
+		m_Count( 0 ),
+		m_Shift( 0 )
+	{
+	}
+
+	// Returns the node holding a state equal to State, or NULL if there is none
+	template <class UserState> Node *Find( UserState &State )
+	{
+		if( m_Count == 0 )
+		{
+			return NULL;
+		}
+
+		size_t hash = State.Hash();
+		size_t mask = m_Slots.size() - 1;
+
+		for( size_t slot = Bucket( hash ); m_Slots[slot]; slot = (slot + 1) & mask )
+		{
+			if( m_Hashes[slot] == hash && m_Slots[slot]->m_UserState.IsSameState( State ) )
+			{
+				return m_Slots[slot];
+			}
+		}
+
+		return NULL;
+	}
+
+	// Adds a node, the caller guarantees no node with the same state is in the index already
+	void Insert( Node *node )
+	{
+		if( (m_Count + 1) * 2 > m_Slots.size() )
+		{
+			Grow();
+		}
+
+		Place( node, node->m_UserState.Hash() );
+		m_Count ++;
+	}
+
+	void Erase( Node *node )
+	{
+		size_t mask = m_Slots.size() - 1;
+		size_t slot = Bucket( node->m_UserState.Hash() );
+
+		while( m_Slots[slot] != node )
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		// Backward shift deletion keeps every probe sequence unbroken without tombstones
+		for( size_t next = (slot + 1) & mask; m_Slots[next]; next = (next + 1) & mask )
+		{
+			size_t home = Bucket( m_Hashes[next] );
+
+			if( ((next - home) & mask) >= ((next - slot) & mask) )
+			{
+				m_Slots[slot] = m_Slots[next];
+				m_Hashes[slot] = m_Hashes[next];
+				slot = next;
+			}
+		}
+
+		m_Slots[slot] = NULL;
+		m_Count --;
+	}
+
+	void Clear()
+	{
+		if( m_Count )
+		{
+			fill( m_Slots.begin(), m_Slots.end(), (Node *)NULL );
+			m_Count = 0;
+		}
+	}
+
+	size_t MemoryUsage() const
+	{
+		return m_Slots.capacity() * sizeof( Node * ) + m_Hashes.capacity() * sizeof( size_t );
+	}
+
+private:
+
+	size_t Bucket( size_t hash ) const
+	{
+		// Fibonacci hashing spreads out user hashes that are just small integers
+		return (size_t)( ((unsigned long long)hash * 0x9E3779B97F4A7C15ULL) >> m_Shift );
+	}
+
+	void Place( Node *node, size_t hash )
+	{
+		size_t mask = m_Slots.size() - 1;
+		size_t slot = Bucket( hash );
+
+		while( m_Slots[slot] )
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		m_Slots[slot] = node;
+		m_Hashes[slot] = hash;
+	}
+
+	void Grow()
+	{
+		vector< Node * > oldSlots;
+		vector< size_t > oldHashes;
+
+		oldSlots.swap( m_Slots );
+		oldHashes.swap( m_Hashes );
+
+		size_t bits = 4;
+
+		while( ((size_t)1 << bits) < oldSlots.size() * 2 )
+		{
+			bits ++;
+		}
+
+		m_Slots.assign( (size_t)1 << bits, (Node *)NULL );
+		m_Hashes.assign( (size_t)1 << bits, 0 );
+		m_Shift = 64 - bits;
+
+		for( size_t i = 0; i < oldSlots.size(); i ++ )
+		{
+			if( oldSlots[i] )
+			{
+				Place( oldSlots[i], oldHashes[i] );
+			}
+		}
+	}
+
+	vector< Node * > m_Slots;
+	vector< size_t > m_Hashes;
+	size_t m_Count;
+	unsigned int m_Shift;
+};
+
+// Open list policies. The open list is a priority queue that keeps each node's position in Node::m_ListIndex, so a
+// node whose f has been lowered can be sifted into place (decrease-key) instead of rebuilding the whole heap.
+// Compare has the same meaning as for the STL heap functions: Compare( x, y ) is true if x comes out after y.
+
+template <class Node, class Compare, unsigned int Arity> class AStarDaryHeap // Heap with Arity children per entry
+{
+public:
+
+	bool Empty() const { return m_Heap.empty(); }
+	size_t Size() const { return m_Heap.size(); }
+	size_t MemoryUsage() const { return m_Heap.capacity() * sizeof( Node * ); }
+	Node *operator[]( size_t i ) const { return m_Heap[i]; }
+	Node *Top() const { return m_Heap.front(); }
+
+	void Push( Node *node )
+	{
+		m_Heap.push_back( node );
+		SiftUp( m_Heap.size() - 1, node );
+	}
+
+	Node *Pop()
+	{
+		Node *top = m_Heap.front();
+		Node *last = m_Heap.back();
+
+		m_Heap.pop_back();
+
+		if( !m_Heap.empty() )
+		{
+			SiftDown( 0, last );
+		}
+
+		return top;
+	}
+
+	// The node's key has decreased, move it up to its new place
+	void Update( Node *node )
+	{
+		SiftUp( node->m_ListIndex, node );
+	}
+
+	// The node's key has changed either way, move it to its new place
+	void Reposition( Node *node )
+	{
+		SiftUp( node->m_ListIndex, node );
+		SiftDown( node->m_ListIndex, node );
+	}
+
+	// Restores the heap order after the keys of many nodes have changed
+	void Rebuild()
+	{
+		for( size_t i = m_Heap.size() > 1 ? (m_Heap.size() - 2) / Arity + 1 : 0; i -- > 0; )
+		{
+			SiftDown( i, m_Heap[i] );
+		}
+	}
+
+	// Takes a node out of the heap from wherever it is
+	void Remove( Node *node )
+	{
+		Node *last = m_Heap.back();
+
+		m_Heap.pop_back();
+
+		if( last != node )
+		{
+			Place( node->m_ListIndex, last );
+			Reposition( last );
+		}
+	}
+
+	void Clear()
+	{
+		m_Heap.clear();
+	}
+
+private:
+
+	void SiftUp( size_t hole, Node *node )
+	{
+		while( hole > 0 )
+		{
+			size_t parent = (hole - 1) / Arity;
+
+			if( !m_Compare( m_Heap[parent], node ) )
+			{
+				break;
+			}
+
+			Place( hole, m_Heap[parent] );
+			hole = parent;
+		}
+
+		Place( hole, node );
+	}
+
+	void SiftDown( size_t hole, Node *node )
+	{
+		size_t count = m_Heap.size();
+
+		for( ;; )
+		{
+			size_t first = hole * Arity + 1;
+
+			if( first >= count )
+			{
+				break;
+			}
+
+			// find the best child
+			size_t last = first + Arity < count ? first + Arity : count;
+			size_t best = first;
+
+			for( size_t child = first + 1; child < last; child ++ )
+			{
+				if( m_Compare( m_Heap[best], m_Heap[child] ) )
+				{
+					best = child;
+				}
+			}
+
+			if( !m_Compare( node, m_Heap[best] ) )
+			{
+				break;
+			}
+
+			Place( hole, m_Heap[best] );
+			hole = best;
+		}
+
+		Place( hole, node );
+	}
+
+	void Place( size_t i, Node *node )
+	{
+		m_Heap[i] = node;
+		node->m_ListIndex = (unsigned int)i;
+	}
+
+	vector< Node * > m_Heap;
+	Compare m_Compare;
+};
+
+template <class Node, class Compare> class AStarBinaryHeap : public AStarDaryHeap< Node, Compare, 2 > // The default open list
+{
+};
+
+template <class Node, class Compare> class AStarQuaternaryHeap : public AStarDaryHeap< Node, Compare, 4 > // Shallower heap, fewer cache misses on large open lists
+{
+};
+
+// Bucket queue (Dial's algorithm) for searches whose f only takes whole values, such as integer edge costs with an
+// integer or zero heuristic. There is one bucket per f value and the lowest non-empty one is tracked, so pushing,
+// popping and lowering f are O(1) apart from stepping over empty buckets, and A* pops f in rising order so the
+// steps add up to the range of f. f may still go down, the buckets grow at the front when it does. Compare is not
+// used, nodes with the same f come out newest first.
+//
+// The open nodes are kept densely in m_Slots, m_ListIndex is a node's slot, and each bucket is a doubly linked list
+// of slots.
+
+template <class Node, class Compare> class AStarBucketQueue
+{
+public:
+
+	AStarBucketQueue() :
+		m_Base( 0 ),
+		m_Min( 0 )
+	{
+	}
+
+	bool Empty() const { return m_Slots.empty(); }
+	size_t Size() const { return m_Slots.size(); }
+	size_t MemoryUsage() const { return m_Slots.capacity() * sizeof( Slot ) + m_Buckets.capacity() * sizeof( unsigned int ); }
+	Node *operator[]( size_t i ) const { return m_Slots[i].node; }
+	Node *Top() const { return m_Slots[ m_Buckets[m_Min] ].node; }
+
+	void Push( Node *node )
+	{
+		node->m_ListIndex = (unsigned int)m_Slots.size();
+		m_Slots.push_back( Slot( node ) );
+		Link( node->m_ListIndex );
+	}
+
+	Node *Pop()
+	{
+		Node *top = Top();
+		Remove( top );
+
+		// drop the empty buckets left behind once they are most of the array
+		if( m_Min >= MinBucketsToDrop && m_Min * 2 > m_Buckets.size() )
+		{
+			m_Buckets.erase( m_Buckets.begin(), m_Buckets.begin() + m_Min );
+			m_Base += m_Min;
+			m_Min = 0;
+		}
+
+		return top;
+	}
+
+	// The node's key has decreased, move it to its new bucket
+	void Update( Node *node )
+	{
+		Reposition( node );
+	}
+
+	// The node's key has changed either way, move it to its new bucket
+	void Reposition( Node *node )
+	{
+		Unlink( node->m_ListIndex );
+		Link( node->m_ListIndex );
+		FindMin();
+	}
+
+	// Puts every node back in the bucket for its key after the keys of many nodes have changed
+	void Rebuild()
+	{
+		fill( m_Buckets.begin(), m_Buckets.end(), (unsigned int)NoSlot );
+
+		for( size_t i = 0; i < m_Slots.size(); i ++ )
+		{
+			Link( (unsigned int)i );
+		}
+
+		m_Min = 0;
+		FindMin();
+	}
+
+	// Takes a node out of the queue from wherever it is
+	void Remove( Node *node )
+	{
+		unsigned int slot = node->m_ListIndex;
+		unsigned int last = (unsigned int)m_Slots.size() - 1;
+
+		Unlink( slot );
+
+		if( slot != last )
+		{
+			// move the last slot into the hole and point its neighbours at it
+			m_Slots[slot] = m_Slots[last];
+			m_Slots[slot].node->m_ListIndex = slot;
+
+			Slot &moved = m_Slots[slot];
+
+			if( moved.prev != NoSlot )
+			{
+				m_Slots[moved.prev].next = slot;
+			}
+			else
+			{
+				m_Buckets[ moved.key - m_Base ] = slot;
+			}
+
+			if( moved.next != NoSlot )
+			{
+				m_Slots[moved.next].prev = slot;
+			}
+		}
+
+		m_Slots.pop_back();
+		FindMin();
+	}
+
+	void Clear()
+	{
+		m_Slots.clear();
+		m_Buckets.clear();
+		m_Base = 0;
+		m_Min = 0;
+	}
+
+private:
+
+	enum
+	{
+		NoSlot = 0xFFFFFFFF,
+		MinBucketsToDrop = 1024,
+	};
+
+	class Slot
+	{
+		public:
+
+			Node *node;
+			long long key; // the bucket the node is in, f when it was linked
+			unsigned int prev;
+			unsigned int next;
+			Slot( Node *n ) : node( n ), key( 0 ), prev( NoSlot ), next( NoSlot ) {}
+	};
+
+	// Puts a slot at the front of the bucket for its node's f
+	void Link( unsigned int slot )
+	{
+		Slot &s = m_Slots[slot];
+
+		s.key = (long long)s.node->f;
+
+		if( m_Buckets.empty() || m_Slots.size() == 1 )
+		{
+			m_Base = s.key; // nothing else is queued, start the buckets here
+		}
+		else if( s.key < m_Base )
+		{
+			// grow at the front, by at least the current size so that a falling f costs O(1) amortised
+			size_t grow = (size_t)( m_Base - s.key );
+			grow = max( grow, m_Buckets.size() );
+			m_Buckets.insert( m_Buckets.begin(), grow, (unsigned int)NoSlot );
+			m_Base -= (long long)grow;
+			m_Min += grow;
+		}
+
+		size_t bucket = (size_t)( s.key - m_Base );
+
+		if( bucket >= m_Buckets.size() )
+		{
+			m_Buckets.resize( bucket + 1, (unsigned int)NoSlot );
+		}
+
+		s.prev = NoSlot;
+		s.next = m_Buckets[bucket];
+
+		if( s.next != NoSlot )
+		{
+			m_Slots[s.next].prev = slot;
+		}
+
+		m_Buckets[bucket] = slot;
+
+		if( m_Slots.size() == 1 || bucket < m_Min )
+		{
+			m_Min = bucket;
+		}
+	}
+
+	void Unlink( unsigned int slot )
+	{
+		Slot &s = m_Slots[slot];
+
+		if( s.prev != NoSlot )
+		{
+			m_Slots[s.prev].next = s.next;
+		}
+		else
+		{
+			m_Buckets[ s.key - m_Base ] = s.next;
+		}
+
+		if( s.next != NoSlot )
+		{
+			m_Slots[s.next].prev = s.prev;
+		}
+	}
+
+	// Moves m_Min up to the first non-empty bucket
+	void FindMin()
+	{
+		if( m_Slots.empty() )
+		{
+			m_Min = 0;
+			return;
+		}
+
+		while( m_Buckets[m_Min] == NoSlot )
+		{
+			m_Min ++;
+		}
+	}
+
+	vector< Slot > m_Slots;
+	vector< unsigned int > m_Buckets; // first slot of each bucket, bucket i holds f == m_Base + i
+	long long m_Base;
+	size_t m_Min; // the lowest non-empty bucket
+};
+
+// The open list to use for Node: the bucket queue when f is of an integer type, a binary heap otherwise
+template <class Node, class Compare> class AStarAutoOpenList :
+	public conditional< is_integral< decltype( Node::f ) >::value, AStarBucketQueue< Node, Compare >, AStarBinaryHeap< Node, Compare > >::type
+{
+};
+
+// Fixed block node pool. Nodes are carved out of blocks that are kept for the lifetime of the pool, freed nodes go on
+// a free list and are handed out again, so once the pool is warm a search makes no calls to the heap allocator.
+
+template <class Node> class AStarNodePool
+{
+public:
+
+	// Capacity is the most nodes that can be in use at once, 0 means no limit
+	AStarNodePool( unsigned int Capacity = 0, unsigned int NodesPerBlock = 1024 ) :
+		m_FreeList( NULL ),
+		m_Capacity( Capacity ),
+		m_NodesPerBlock( NodesPerBlock ),
+		m_InUse( 0 ),
+		m_Reserved( 0 )
+	{
+		if( m_Capacity && m_NodesPerBlock > m_Capacity )
+		{
+			m_NodesPerBlock = m_Capacity;
+		}
+	}
+
+	~AStarNodePool()
+	{
+		for( size_t i = 0; i < m_Blocks.size(); i ++ )
+		{
+			::operator delete( m_Blocks[i] );
+		}
+	}
+
+	// Returns a default constructed node, or NULL when the pool is at capacity
+	Node *Allocate()
+	{
+		if( m_Capacity && m_InUse >= m_Capacity )
+		{
+			return NULL;
+		}
+
+		if( !m_FreeList )
+		{
+			AddBlock();
+		}
+
+		FreeSlot *slot = m_FreeList;
+		m_FreeList = slot->next;
+		m_InUse ++;
+
+		return new( slot ) Node;
+	}
+
+	void Free( Node *node )
+	{
+		node->~Node();
+
+		FreeSlot *slot = reinterpret_cast< FreeSlot * >( node );
+		slot->next = m_FreeList;
+		m_FreeList = slot;
+		m_InUse --;
+	}
+
+	// Makes sure at least Count nodes can be allocated without growing the pool
+	void Reserve( unsigned int Count )
+	{
+		if( m_Capacity && Count > m_Capacity )
+		{
+			Count = m_Capacity;
+		}
+
+		while( m_Reserved < Count )
+		{
+			AddBlock();
+		}
+	}
+
+	unsigned int GetCapacity() const { return m_Capacity; }
+	unsigned int GetReservedCount() const { return m_Reserved; }
+	size_t MemoryUsage() const { return (size_t)m_Reserved * sizeof( Slot ) + m_Blocks.capacity() * sizeof( Slot * ); }
+
+private:
+
+	struct FreeSlot
+	{
+		FreeSlot *next;
+	};
+
+	union Slot // storage for one node, big enough to double as a free list entry
+	{
+		char node[ sizeof( Node ) ];
+		FreeSlot *next;
+	};
+
+	void AddBlock()
+	{
+		Slot *block = static_cast< Slot * >( ::operator new( sizeof( Slot ) * m_NodesPerBlock ) );
+
+		m_Blocks.push_back( block );
+
+		// thread the new slots onto the free list, lowest address first
+		for( unsigned int i = m_NodesPerBlock; i > 0; i -- )
+		{
+			FreeSlot *slot = reinterpret_cast< FreeSlot * >( &block[i - 1] );
+			slot->next = m_FreeList;
+			m_FreeList = slot;
+		}
+
+		m_Reserved += m_NodesPerBlock;
+	}
+
+	// the pool owns raw memory so it can't be copied
+	AStarNodePool( const AStarNodePool & );
+	AStarNodePool &operator=( const AStarNodePool & );
+
+	vector< Slot * > m_Blocks;
+	FreeSlot *m_FreeList;
+	unsigned int m_Capacity;
+	unsigned int m_NodesPerBlock;
+	unsigned int m_InUse;
+	unsigned int m_Reserved;
+};
+
+// Trace policies. The search reports what it is doing to its tracer, the default tracer does nothing and compiles away
+// so the search never touches iostreams unless a tracer that prints is asked for.
+
+class AStarNoTrace
+{
+public:
+
+	template <class UserState> void NodeExpanded( UserState & ) {}
+};
+
+class AStarPrintTrace // Prints each node as it is expanded, the way the Romania demo shows the search
+{
+public:
+
+	template <class UserState> void NodeExpanded( UserState &State )
+	{
+		State.PrintNodeInfo();
+		cout << " is selected for Expansion\n\n";
+	}
+};
+
+// Search statistics. Build with -DASTAR_COLLECT_STATS for AStarSearch to count what each search does, and with
+// -DASTAR_COLLECT_TIMING as well to time successor generation and heap maintenance. Without them the counting
+// statements compile away and GetStats returns zeros. Timing reads the clock twice around every heap operation, so
+// it slows the search noticeably and is only meant for finding out where a slow query spends its time.
+
+#ifdef ASTAR_COLLECT_TIMING
+#ifndef ASTAR_COLLECT_STATS
+#define ASTAR_COLLECT_STATS
+#endif
+#endif
+
+#ifdef ASTAR_COLLECT_STATS
+#define ASTAR_STAT( Statement ) Statement
+#else
+#define ASTAR_STAT( Statement )
+#endif
+
+class AStarSearchStats // What one search did, reset by SetStartAndGoalStates
+{
+public:
+
+	unsigned int expansions;
+	unsigned int successorsGenerated; // successors the user state added
+	unsigned int prunedByOpen; // successors dropped because the open list had the state at no greater cost
+	unsigned int prunedByClosed; // the same for the closed list
+	unsigned int reopened; // closed nodes reached more cheaply and put back on the open list
+	unsigned int heapPushes;
+	unsigned int heapPops;
+	unsigned int heapUpdates; // open nodes whose f was lowered and sifted into place
+	unsigned int heapRebuilds; // whole heap reorders, one per iteration of an anytime search
+	unsigned int peakOpen;
+	unsigned int peakClosed;
+	uint64_t successorNanoseconds; // in GetSuccessors and the heuristic, with ASTAR_COLLECT_TIMING
+	uint64_t heapNanoseconds; // in heap pushes, pops and updates, with ASTAR_COLLECT_TIMING
+
+	AStarSearchStats()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		memset( this, 0, sizeof( *this ) );
+	}
+};
+
+// Adds the time from its construction to its destruction to a total, or does nothing without ASTAR_COLLECT_TIMING
+class AStarPhaseTimer
+{
+public:
+
+#ifdef ASTAR_COLLECT_TIMING
+	AStarPhaseTimer( uint64_t &Total ) :
+		m_Total( Total ),
+		m_Started( chrono::steady_clock::now() )
+	{
+	}
+
+	~AStarPhaseTimer()
+	{
+		m_Total += (uint64_t)chrono::duration_cast< chrono::nanoseconds >( chrono::steady_clock::now() - m_Started ).count();
+	}
+
+private:
+
+	uint64_t &m_Total;
+	chrono::steady_clock::time_point m_Started;
+#else
+	AStarPhaseTimer( uint64_t & ) {}
+#endif
+};
+
+// Optional batched heuristic. A UserState can provide
+//
+//   void GoalDistanceEstimateBatch( UserState *const *States, unsigned int Count, UserState &nodeGoal, float *Estimates );
+//
+// which must give Estimates[i] the same value as States[i]->GoalDistanceEstimate( nodeGoal ). The search then
+// scores all the successors of a node with one call per expansion instead of one call per successor, so a state
+// with coordinates can gather them into arrays and estimate several successors at once with SIMD.
+
+template <class UserState> class AStarHasBatchEstimate
+{
+	template <class T> static char Test( decltype( declval< T & >().GoalDistanceEstimateBatch( declval< T *const * >(), 0u, declval< T & >(), declval< float * >() ) ) * );
+	template <class T> static long Test( ... );
+
+public:
+
+	enum { Value = sizeof( Test< UserState >( 0 ) ) == 1 };
+};
+
+template <class UserState, bool Batched = AStarHasBatchEstimate< UserState >::Value> class AStarBatchEstimate
+{
+public:
+
+	enum { IsBatched = 0 };
+
+	static void Estimate( UserState &, UserState *const *, unsigned int, UserState &, float * ) {}
+};
+
+template <class UserState> class AStarBatchEstimate< UserState, true >
+{
+public:
+
+	enum { IsBatched = 1 };
+
+	static void Estimate( UserState &Parent, UserState *const *States, unsigned int Count, UserState &Goal, float *Estimates )
+	{
+		Parent.GoalDistanceEstimateBatch( States, Count, Goal, Estimates );
+	}
+};
+
+// Heuristic policies for AStarSearch, which decide how a node's h is found and whether the node stores one at all.
+// NodeData adds the policy's fields to the rest of the node's (Links). AStarGoalEstimate asks the state through
+// GoalDistanceEstimate. AStarZeroEstimate makes the search Dijkstra's algorithm: h is a constant 0, so the nodes have
+// no h field and GoalDistanceEstimate is never called.
+
+class AStarGoalEstimate
+{
+public:
+
+	enum { IsZero = 0 };
+
+	template <class Cost, class Links> class NodeData : public Links
+	{
+		public:
+
+			Cost h; // heuristic estimate of distance to goal
+			NodeData() : h( 0 ) {}
+			Cost GetH() const { return h; }
+			void SetH( Cost H ) { h = H; }
+	};
+
+	template <class Cost, class UserState> static Cost Estimate( UserState &State, UserState &Goal )
+	{
+		return (Cost)State.GoalDistanceEstimate( Goal );
+	}
+};
+
+class AStarZeroEstimate
+{
+public:
+
+	enum { IsZero = 1 };
+
+	template <class Cost, class Links> class NodeData : public Links
+	{
+		public:
+
+			Cost GetH() const { return 0; }
+			void SetH( Cost ) {}
+	};
+
+	template <class Cost, class UserState> static Cost Estimate( UserState &, UserState & )
+	{
+		return 0;
+	}
+};
+
+// Cost is the type of g, h and f, float by default. An integer type keeps costs exact and, through
+// AStarAutoOpenList, orders the open list with a bucket queue. GetCost and GoalDistanceEstimate results are
+// converted to it.
+template <class UserState, template <class> class StateIndex = AStarLinearIndex, template <class, class> class OpenList = AStarAutoOpenList, class Trace = AStarNoTrace, class Cost = float, class Heuristic = AStarGoalEstimate> class AStarSearch // The A* search class. UserState is used to retrieve data of a particular state.
+{
+
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	enum // which list a node is currently on
+	{
+		LIST_NONE,
+		LIST_OPEN,
+		LIST_CLOSED,
+		LIST_FOCAL, // on the open list and the focal list, focal search only
+		LIST_EXPANDED, // closed in the current iteration of an anytime search, not reopened until the next
+		LIST_INCONSISTENT, // expanded in this iteration and reached more cheaply since, reopened by the next
+	};
+
+	public:
+
+	class Node;
+
+	class NodeLinks // The fields every node has, NodeData adds h after them so it packs in behind the pointers
+	{
+		public:
+			Node *parent; // used during the search to record the parent of successor nodes
+			Node *child; // used after the search for the application to view the search in reverse
+			Cost g; // cost of this node + it's predecessors
+			Cost f; // sum of cumulative cost of predecessors and self and heuristic
+			unsigned int m_List; // LIST_OPEN or LIST_CLOSED while the node is held by the state index
+			unsigned int m_ListIndex; // position in the open heap or the closed list, lets the node be found without a search
+			NodeLinks() :
+				parent( 0 ),
+				child( 0 ),
+				g( 0 ),
+				f( 0 ),
+				m_List( LIST_NONE ),
+				m_ListIndex( 0 )
+			{}
+	};
+
+	class Node : public Heuristic::template NodeData< Cost, NodeLinks > // A node represents a possible state in the search.
+    {
+        public:
+            UserState m_UserState;
+	};
+
+    class HeapCompare_f // For sorting the heap the STL needs compare function that lets us compare the f value of two nodes
+	{
+		public:
+
+			bool operator() ( const Node *x, const Node *y ) const
+			{
+				return x->f > y->f;
+			}
+	};
+
+	class SearchResult // Outcome of a one-shot Search()
+	{
+		public:
+
+			unsigned int state; // SEARCH_STATE_SUCCEEDED, SEARCH_STATE_FAILED or SEARCH_STATE_OUT_OF_MEMORY, SEARCH_STATE_SEARCHING if the budget ran out first
+			vector< UserState > path; // the solution from start to goal, empty unless the search succeeded
+			Cost cost; // cost of the solution, the largest Cost unless the search succeeded
+			unsigned int steps; // search steps taken so far
+			unsigned int nodesExpanded; // nodes whose successors were generated so far
+			float bound; // the solution costs at most bound times the optimal cost, 1 unless suboptimal solutions were allowed
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( numeric_limits< Cost >::max() ),
+				steps( 0 ),
+				nodesExpanded( 0 ),
+				bound( 1.0f )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef UserState UserStateType;
+
+	typedef Cost CostType;
+
+	enum { SolutionChunkSize = 256 }; // the most ids StreamSolution passes to its sink at a time
+
+
+public: // methods
+
+
+	// constructor just initializes private data
+	// MaxNodes caps how many nodes the search may hold at once, 0 lets the node pool grow as needed
+	AStarSearch( unsigned int MaxNodes = 0 ) :
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Steps( 0 ),
+		m_NodesExpanded( 0 ),
+		m_Weight( 1.0f ),
+		m_Focal( false ),
+		m_HeuristicWeight( 1.0f ),
+		m_FocalBound( 0 ),
+		m_Anytime( false ),
+		m_AnytimeStep( 0.0f ),
+		m_AnytimeGoal( NULL ),
+		m_AnytimeWeight( 1.0f ),
+		m_SolutionBound( 1.0f ),
+		m_SolutionHeld( false ),
+		m_SolutionLinked( false ),
+		m_CurrentSolutionNode( NULL ),
+		m_NodePool( MaxNodes ),
+		m_AllocateNodeCount(0),
+		m_PeakAllocateNodeCount(0)
+	{
+	}
+
+	// Pre-allocates node storage so the first searches don't need to grow the pool
+	void ReserveNodes( unsigned int Count )
+	{
+		m_NodePool.Reserve( Count );
+	}
+
+	// Bounded suboptimal search, for when a path a little longer than the best is worth finding in far less time.
+	// Solutions cost at most Weight times the optimal cost, so 1.1 allows 10% more and 1 (the default) is plain A*.
+	// The bound holds as long as the heuristic never overestimates.
+	//
+	// Weighted A* orders the open list by g + Weight * h, which heads for the goal more greedily. Focal search keeps
+	// the order by f, but of the open nodes whose f is within Weight of the smallest (the focal list) it expands the
+	// one with the smallest h, the one that looks closest to the goal. Takes effect from the next SetStartAndGoalStates.
+	void SetSuboptimalBound( float Weight, bool Focal = false )
+	{
+		m_Weight = max( Weight, 1.0f );
+		m_Focal = Focal && m_Weight > 1.0f;
+	}
+
+	// Set Start and goal states
+	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	{
+		// the nodes of a solution that was never freed would otherwise be lost to the pool
+		if( m_SolutionHeld )
+		{
+			FreeSolutionNodes();
+		}
+
+		m_Start = AllocateNode();
+		m_Goal = AllocateNode();
+
+		// Initialize counters for search steps and expansions
+		m_Steps = 0;
+		m_NodesExpanded = 0;
+		m_Stats.Clear();
+
+		// SearchAnytime sets its own weight when it starts
+		m_HeuristicWeight = m_Focal ? 1.0f : m_Weight;
+		m_Anytime = false;
+		m_AnytimeGoal = NULL;
+		m_SolutionBound = 1.0f;
+		m_FocalList.clear();
+		m_FocalPending.clear();
+
+		if( !m_Start || !m_Goal )
+		{
+			// the pool is too small to even hold the start and goal
+			if( m_Start ) FreeNode( m_Start );
+			if( m_Goal ) FreeNode( m_Goal );
+			m_Start = m_Goal = NULL;
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return;
+		}
+
+		m_Start->m_UserState = Start;
+		m_Goal->m_UserState = Goal;
+
+		m_State = SEARCH_STATE_SEARCHING;
+
+		// Initialize the AStar specific parts of the Start Node. The user only needs fill out the state information.
+
+		m_Start->g = 0;
+		m_Start->SetH( Heuristic::template Estimate< Cost >( m_Start->m_UserState, m_Goal->m_UserState ) );
+		m_Start->f = WeightedF( m_Start );
+		m_Start->parent = 0;
+
+		// Push the start node on the Open list
+        m_OpenList.Push( m_Start );
+		m_Start->m_List = LIST_OPEN;
+		m_Index.Insert( m_Start );
+		m_FocalBound = (Cost)( m_Weight * m_Start->f );
+		Opened( m_Start );
+		ASTAR_STAT( m_Stats.heapPushes ++ );
+		ASTAR_STAT( m_Stats.peakOpen = 1 );
+	}
+
+	// Advances search one step
+	unsigned int SearchStep()
+	{
+
+		// Next we want it to be safe to do a search step once the search has succeeded, failed or not started...
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			return m_State;
+		}
+
+		// Failure is defined as emptying the open list as there is nothing left to search
+		if( m_OpenList.Empty() )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+			return m_State;
+		}
+
+		// Increment step count
+		m_Steps ++;
+
+		// Pop the best node (the one with the lowest f)
+		Node *n;
+
+		{
+			AStarPhaseTimer timer( m_Stats.heapNanoseconds );
+			n = IsFocal() ? PopFocal() : m_OpenList.Pop(); // get pointer to the node
+		}
+
+		ASTAR_STAT( m_Stats.heapPops ++ );
+
+		// Check for the goal, once we pop that we're done
+		if( n->m_UserState.IsGoal( m_Goal->m_UserState ) )
+		{
+			if( m_Anytime && m_HeuristicWeight > 1.0f )
+			{
+				// The goal had the smallest f, so this solution is within the weight of optimal. The goal goes back on
+				// the open list and the next iteration carries on with a lower weight.
+				m_AnytimeGoal = n;
+				m_AnytimeWeight = m_HeuristicWeight;
+				m_OpenList.Push( n );
+				n->m_List = LIST_OPEN;
+				NextAnytimeIteration();
+
+				return m_State;
+			}
+
+			Succeed( n, m_Anytime ? 1.0f : m_Weight );
+
+			return m_State;
+		}
+		else // not goal
+		{
+
+			// We now need to generate the successors of this node.
+
+			m_Successors.clear(); // empty vector of successor nodes of n
+
+			bool ret;
+
+			{
+				AStarPhaseTimer timer( m_Stats.successorNanoseconds );
+				ret = n->m_UserState.GetSuccessors( this, n->parent ? &n->parent->m_UserState : NULL );
+			}
+
+			if( !ret )
+			{
+				// The node pool ran out while adding successors, free everything and give up
+				typename vector< Node * >::iterator successor;
+
+				for( successor = m_Successors.begin(); successor != m_Successors.end(); successor ++ )
+				{
+					FreeNode( (*successor) );
+				}
+
+				m_Successors.clear();
+
+				FreeNode( n );
+				FreeAllNodes();
+
+				m_State = SEARCH_STATE_OUT_OF_MEMORY;
+				return m_State;
+			}
+
+			m_NodesExpanded ++;
+			m_Trace.NodeExpanded( n->m_UserState );
+			ASTAR_STAT( m_Stats.expansions ++ );
+			ASTAR_STAT( m_Stats.successorsGenerated += (unsigned int)m_Successors.size() );
+
+			// States with a batched heuristic are scored with one call per expansion. Successors that can't improve on a
+			// node already on the open or closed list are dropped first, so only the ones that are kept get scored. New
+			// states go into the index straight away, still off both lists, so that a later successor with the same
+			// state is merged into them here.
+			if( BatchedEstimate )
+			{
+				size_t kept = 0;
+
+				if( m_SuccessorStates.size() < m_Successors.size() ) // only ever grows, so there's no clearing per expansion
+				{
+					m_SuccessorStates.resize( m_Successors.size() );
+					m_SuccessorExisting.resize( m_Successors.size() );
+					m_SuccessorEstimates.resize( m_Successors.size() );
+				}
+
+				for( size_t i = 0; i < m_Successors.size(); i ++ )
+				{
+					Node *successor = m_Successors[i];
+					Cost newg = n->g + (Cost)n->m_UserState.GetCost( successor->m_UserState );
+
+					Node *existing = FindNode( successor->m_UserState );
+
+					if( existing && existing->m_List == LIST_NONE )
+					{
+						// an earlier successor of n, keep the cheaper of the two
+						if( newg < existing->g )
+						{
+							existing->g = newg;
+							existing->m_UserState = successor->m_UserState;
+						}
+
+						FreeNode( successor );
+						continue;
+					}
+
+					if( existing && existing->g <= newg )
+					{
+						ASTAR_STAT( ( IsOpen( existing ) ? m_Stats.prunedByOpen : m_Stats.prunedByClosed ) ++ );
+						FreeNode( successor );
+						continue;
+					}
+
+					if( !existing )
+					{
+						m_Index.Insert( successor );
+					}
+
+					successor->g = newg;
+					m_SuccessorStates[kept] = &successor->m_UserState;
+					m_SuccessorExisting[kept] = existing;
+					m_Successors[ kept ++ ] = successor;
+				}
+
+				m_Successors.resize( kept );
+
+				if( kept )
+				{
+					AStarPhaseTimer timer( m_Stats.successorNanoseconds );
+					AStarBatchEstimate< UserState >::Estimate( n->m_UserState, &m_SuccessorStates[0], (unsigned int)kept, m_Goal->m_UserState, &m_SuccessorEstimates[0] );
+				}
+			}
+
+			// Now handle each successor to the current node ...
+			for( typename vector< Node * >::iterator successor = m_Successors.begin(); successor != m_Successors.end(); successor ++ )
+			{
+				Cost newg;
+				Node *existing;
+
+				if( BatchedEstimate )
+				{
+					// Already costed and looked up above. Without an index the lists are searched again, in case an
+					// earlier successor of this node had the same state and has since been added.
+					newg = (*successor)->g;
+					existing = m_SuccessorExisting[ successor - m_Successors.begin() ];
+
+					if( !existing && !StateIndex< Node >::IsIndexed )
+					{
+						existing = FindNode( (*successor)->m_UserState );
+					}
+				}
+				else
+				{
+					// 	The g value for this successor ...
+					newg = n->g + (Cost)n->m_UserState.GetCost( (*successor)->m_UserState );
+
+					// Now we need to find whether the node is on the open or closed lists If it is but the node that is already on them is better (lower g) then we can forget about this successor
+
+					existing = FindNode( (*successor)->m_UserState );
+				}
+
+				if( existing && existing->g <= newg )
+				{
+					// the one on Open or Closed is cheaper than this one
+					ASTAR_STAT( ( IsOpen( existing ) ? m_Stats.prunedByOpen : m_Stats.prunedByClosed ) ++ );
+					FreeNode( (*successor) );
+
+					continue;
+				}
+
+				// This node is the best node so far with this particular state so lets keep it and set up its A* specific data ...
+
+				(*successor)->parent = n;
+				(*successor)->g = newg;
+				if( BatchedEstimate )
+				{
+					(*successor)->SetH( (Cost)m_SuccessorEstimates[ successor - m_Successors.begin() ] );
+				}
+				else if( !Heuristic::IsZero )
+				{
+					AStarPhaseTimer timer( m_Stats.successorNanoseconds );
+					(*successor)->SetH( Heuristic::template Estimate< Cost >( (*successor)->m_UserState, m_Goal->m_UserState ) );
+				}
+				(*successor)->f = WeightedF( *successor );
+
+				// Successor was already expanded in this iteration of an anytime search, bring it up to date but
+				// leave it for the next iteration to reopen
+
+				if( existing && ( existing->m_List == LIST_EXPANDED || existing->m_List == LIST_INCONSISTENT ) )
+				{
+					existing->parent = (*successor)->parent;
+					existing->g      = (*successor)->g;
+					existing->SetH( (*successor)->GetH() );
+					existing->f      = (*successor)->f;
+					existing->m_List = LIST_INCONSISTENT;
+
+					FreeNode( (*successor) );
+				}
+
+				// Successor is in closed list and the new copy is cheaper then
+				// 1 - Update old version of this node in closed list
+				// 2 - Move it from closed to open list
+				// 3 - Sort heap again in open list
+
+				else if( existing && existing->m_List == LIST_CLOSED )
+				{
+					// Update closed node with successor node AStar data
+					existing->parent = (*successor)->parent;
+					existing->g      = (*successor)->g;
+					existing->SetH( (*successor)->GetH() );
+					existing->f      = (*successor)->f;
+
+					// Free successor node
+					FreeNode( (*successor) );
+
+					// Remove closed node from closed list
+					RemoveFromClosedList( existing );
+
+					// Push closed node into open list
+					{
+						AStarPhaseTimer timer( m_Stats.heapNanoseconds );
+						m_OpenList.Push( existing );
+					}
+
+					existing->m_List = LIST_OPEN;
+					Opened( existing );
+					ASTAR_STAT( m_Stats.reopened ++ );
+					ASTAR_STAT( m_Stats.heapPushes ++ );
+
+					// Here we have found a new state which is already CLOSED
+
+				}
+
+				// Successor in open list
+				// 1 - Update old version of this node in open list
+				// 2 - move it up the heap to its new place
+
+				else if( existing )
+				{
+					// Update open node with successor node AStar data
+					existing->parent = (*successor)->parent;
+					existing->g      = (*successor)->g;
+					existing->SetH( (*successor)->GetH() );
+					existing->f      = (*successor)->f;
+
+					// Free successor node
+					FreeNode( (*successor) );
+
+					// lower f so sift it up, the rest of the heap is untouched
+					{
+						AStarPhaseTimer timer( m_Stats.heapNanoseconds );
+						m_OpenList.Update( existing );
+					}
+
+					Opened( existing );
+					ASTAR_STAT( m_Stats.heapUpdates ++ );
+				}
+
+				// New successor
+				// 1 - Move it from successors to open list
+				// 2 - sort heap again in open list
+
+				else
+				{
+					// Push successor node into open list
+					{
+						AStarPhaseTimer timer( m_Stats.heapNanoseconds );
+						m_OpenList.Push( (*successor) );
+					}
+
+					(*successor)->m_List = LIST_OPEN;
+					Opened( (*successor) );
+					ASTAR_STAT( m_Stats.heapPushes ++ );
+
+					if( !BatchedEstimate ) // batched successors were indexed above
+					{
+						m_Index.Insert( (*successor) );
+					}
+				}
+
+			}
+
+			// push n onto Closed, as we have expanded it now
+
+			n->m_List = m_Anytime ? LIST_EXPANDED : LIST_CLOSED;
+			n->m_ListIndex = (unsigned int)m_ClosedList.size();
+			m_ClosedList.push_back( n );
+
+			ASTAR_STAT( m_Stats.peakOpen = max( m_Stats.peakOpen, (unsigned int)m_OpenList.Size() ) );
+			ASTAR_STAT( m_Stats.peakClosed = max( m_Stats.peakClosed, (unsigned int)m_ClosedList.size() ) );
+
+		} // end else (not goal so expand)
+
+ 		return m_State; // Succeeded bool is false at this point.
+
+	}
+
+	// Runs the search set up by SetStartAndGoalStates until it succeeds or fails, or until MaxSteps steps (0 for no
+	// limit) have been taken or the Deadline has passed. When the budget runs out the result state is still
+	// SEARCH_STATE_SEARCHING, the search can be resumed with another call or abandoned with CancelSearch.
+	// As after SearchStep, a successful search still needs FreeSolutionNodes once the solution has been used.
+	unsigned int Search( SearchResult &Result, unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64; // reading the clock every step would cost more than the step
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( MaxSteps && stepsTaken >= MaxSteps )
+			{
+				break;
+			}
+
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		FillResult( Result );
+
+		return m_State;
+	}
+
+	SearchResult Search( unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, MaxSteps, Deadline );
+		return result;
+	}
+
+	// Anytime search (ARA*), for when there is a time budget rather than a bound. Call after SetStartAndGoalStates.
+	// A first solution is found with weighted A* at InitialWeight. Each time one is found the weight drops by
+	// WeightStep and the search carries on with the open and closed lists it has, reopening only the nodes whose cost
+	// has come down, so each better solution costs far less than a fresh search. It ends when the weight reaches 1 and
+	// the solution is optimal, or at the Deadline with the best solution so far and Result.bound saying how far from
+	// optimal it can be. A search with no solution by the Deadline is left SEARCHING and can be resumed by calling
+	// again. As after Search, a successful search still needs FreeSolutionNodes.
+	unsigned int SearchAnytime( SearchResult &Result, float InitialWeight, float WeightStep, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64;
+
+		if( m_State == SEARCH_STATE_SEARCHING && !m_Anytime )
+		{
+			m_Anytime = true;
+			m_HeuristicWeight = max( InitialWeight, 1.0f );
+			m_AnytimeStep = WeightStep;
+			Reweight();
+		}
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				if( m_AnytimeGoal )
+				{
+					// out of time, settle for the best solution so far
+					m_OpenList.Remove( m_AnytimeGoal );
+					Succeed( m_AnytimeGoal, AnytimeBound() );
+				}
+
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		FillResult( Result );
+
+		return m_State;
+	}
+
+	// Abandons a search that is still running and frees all of its nodes
+	void CancelSearch()
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// User calls this to add a successor to a list of successors when expanding the search frontier
+	bool AddSuccessor( UserState &State )
+	{
+		Node *node = AllocateNode();
+
+		if( node )
+		{
+			node->m_UserState = State;
+
+			m_Successors.push_back( node );
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// Free the solution nodes. This is done to clean up all used Node memory when you are done with the search.
+	// Afterwards there is no solution to read, and calling it again does nothing.
+	void FreeSolutionNodes()
+	{
+		if( !m_SolutionHeld )
+		{
+			return;
+		}
+
+		// the solution's nodes, start included, are among the nodes the search left behind, only the goal is not
+		for( size_t i = 0; i < m_SearchedNodes.size(); i ++ )
+		{
+			FreeNode( m_SearchedNodes[i] );
+		}
+
+		m_SearchedNodes.clear();
+
+		FreeNode( m_Goal );
+
+		m_Start = m_Goal = NULL;
+		m_State = SEARCH_STATE_NOT_INITIALISED;
+		m_SolutionHeld = false;
+		m_CurrentSolutionNode = NULL;
+	}
+
+	// Functions for traversing the solution
+
+	// Get start node
+	UserState *GetSolutionStart()
+	{
+		LinkSolution();
+
+		m_CurrentSolutionNode = m_Start;
+		if( m_Start )
+		{
+			return &m_Start->m_UserState;
+		}
+		else
+		{
+			return NULL;
+		}
+	}
+
+	// Get next node
+	UserState *GetSolutionNext()
+	{
+		LinkSolution();
+
+		if( m_CurrentSolutionNode )
+		{
+			if( m_CurrentSolutionNode->child )
+			{
+
+				Node *child = m_CurrentSolutionNode->child;
+
+				m_CurrentSolutionNode = m_CurrentSolutionNode->child;
+
+				return &child->m_UserState;
+			}
+		}
+
+		return NULL;
+	}
+
+	// Get end node
+	UserState *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Goal;
+		if( m_Goal )
+		{
+			return &m_Goal->m_UserState;
+		}
+		else
+		{
+			return NULL;
+		}
+	}
+
+	// Step solution iterator backwards
+	UserState *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode )
+		{
+			if( m_CurrentSolutionNode->parent )
+			{
+
+				Node *parent = m_CurrentSolutionNode->parent;
+
+				m_CurrentSolutionNode = m_CurrentSolutionNode->parent;
+
+				return &parent->m_UserState;
+			}
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution
+	// Returns the largest Cost if goal is not defined or there is no solution
+	Cost GetSolutionCost()
+	{
+		if( m_Goal && m_State == SEARCH_STATE_SUCCEEDED )
+		{
+			return m_Goal->g;
+		}
+		else
+		{
+			return numeric_limits< Cost >::max();
+		}
+	}
+
+	// The solution costs at most this many times the optimal cost
+	float GetSolutionBound()
+	{
+		return m_SolutionBound;
+	}
+
+	// Zero-copy alternatives to the solution iterators, for long solutions. They follow the parent pointers back from
+	// the goal, which the search leaves in place, and hand over an id for each state instead of the state. IdOf is any
+	// function or functor that takes a UserState & and returns its id, a node number for instance.
+
+	// The number of states on the solution, start and goal included, 0 if there is none
+	size_t GetSolutionLength()
+	{
+		size_t length = 0;
+
+		if( m_State == SEARCH_STATE_SUCCEEDED )
+		{
+			for( Node *node = m_Goal; node; node = node->parent )
+			{
+				length ++;
+			}
+		}
+
+		return length;
+	}
+
+	// Writes the ids of the solution's states to Ids, start first, or goal first if Reversed. The ids are written as
+	// the parent pointers are followed and then reversed in place, so Reversed saves that pass. Returns the length of
+	// the solution. If that is more than Capacity only the Capacity ids nearest the goal are written, goal first, and
+	// the call should be repeated with a buffer that big.
+	template <class IdFunc, class Id> size_t GetSolutionIds( IdFunc IdOf, Id *Ids, size_t Capacity, bool Reversed = false )
+	{
+		size_t length = 0;
+
+		if( m_State != SEARCH_STATE_SUCCEEDED )
+		{
+			return 0;
+		}
+
+		for( Node *node = m_Goal; node; node = node->parent, length ++ )
+		{
+			if( length < Capacity )
+			{
+				Ids[length] = IdOf( node->m_UserState );
+			}
+		}
+
+		if( length <= Capacity && !Reversed )
+		{
+			reverse( Ids, Ids + length );
+		}
+
+		return length;
+	}
+
+	// Passes the ids of the solution's states to Out( const Id *Ids, size_t Count ) in chunks of up to
+	// SolutionChunkSize, start first, or goal first if Reversed. Goal first, the first chunk goes out before the rest
+	// of the solution has been looked at. Start first needs the whole chain followed before the first chunk. Returns
+	// the length of the solution.
+	template <class IdFunc, class Sink> size_t StreamSolution( IdFunc IdOf, Sink &&Out, bool Reversed = false )
+	{
+		typedef typename decay< decltype( IdOf( m_Goal->m_UserState ) ) >::type Id;
+
+		Id chunk[ SolutionChunkSize ];
+		size_t count = 0;
+		size_t length = 0;
+
+		if( m_State != SEARCH_STATE_SUCCEEDED )
+		{
+			return 0;
+		}
+
+		if( Reversed )
+		{
+			for( Node *node = m_Goal; node; node = node->parent, length ++ )
+			{
+				chunk[ count ++ ] = IdOf( node->m_UserState );
+
+				if( count == SolutionChunkSize )
+				{
+					Out( chunk, count );
+					count = 0;
+				}
+			}
+		}
+		else
+		{
+			// the start is at the far end of the parent pointers, so collect the way back first
+			m_SolutionPath.clear();
+
+			for( Node *node = m_Goal; node; node = node->parent )
+			{
+				m_SolutionPath.push_back( node );
+			}
+
+			for( length = m_SolutionPath.size(); length > 0; length -- )
+			{
+				chunk[ count ++ ] = IdOf( m_SolutionPath[ length - 1 ]->m_UserState );
+
+				if( count == SolutionChunkSize )
+				{
+					Out( chunk, count );
+					count = 0;
+				}
+			}
+
+			length = m_SolutionPath.size();
+		}
+
+		if( count )
+		{
+			Out( chunk, count );
+		}
+
+		return length;
+	}
+
+	// For debugging it is useful to be able to view the open and closed list at each step, here are two functions to allow that.
+
+	UserState *GetOpenListStart()
+	{
+		Cost f,g,h;
+		return GetOpenListStart( f,g,h );
+	}
+
+	UserState *GetOpenListStart( Cost &f, Cost &g, Cost &h )
+	{
+		iterDbgOpen = 0;
+		if( iterDbgOpen < m_OpenList.Size() )
+		{
+			f = m_OpenList[iterDbgOpen]->f;
+			g = m_OpenList[iterDbgOpen]->g;
+			h = m_OpenList[iterDbgOpen]->GetH();
+			return &m_OpenList[iterDbgOpen]->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	UserState *GetOpenListNext()
+	{
+		Cost f,g,h;
+		return GetOpenListNext( f,g,h );
+	}
+
+	UserState *GetOpenListNext( Cost &f, Cost &g, Cost &h )
+	{
+		iterDbgOpen++;
+		if( iterDbgOpen < m_OpenList.Size() )
+		{
+			f = m_OpenList[iterDbgOpen]->f;
+			g = m_OpenList[iterDbgOpen]->g;
+			h = m_OpenList[iterDbgOpen]->GetH();
+			return &m_OpenList[iterDbgOpen]->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	UserState *GetClosedListStart()
+	{
+		Cost f,g,h;
+		return GetClosedListStart( f,g,h );
+	}
+
+	UserState *GetClosedListStart( Cost &f, Cost &g, Cost &h )
+	{
+		iterDbgClosed = m_ClosedList.begin();
+		if( iterDbgClosed != m_ClosedList.end() )
+		{
+			f = (*iterDbgClosed)->f;
+			g = (*iterDbgClosed)->g;
+			h = (*iterDbgClosed)->GetH();
+
+			return &(*iterDbgClosed)->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	UserState *GetClosedListNext()
+	{
+		Cost f,g,h;
+		return GetClosedListNext( f,g,h );
+	}
+
+	UserState *GetClosedListNext( Cost &f, Cost &g, Cost &h )
+	{
+		iterDbgClosed++;
+		if( iterDbgClosed != m_ClosedList.end() )
+		{
+			f = (*iterDbgClosed)->f;
+			g = (*iterDbgClosed)->g;
+			h = (*iterDbgClosed)->GetH();
+
+			return &(*iterDbgClosed)->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	// Get the number of steps
+
+	int GetStepCount() { return m_Steps; }
+
+	// Get the number of nodes expanded
+
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+
+	// Node pool usage: nodes allocated right now, the most ever allocated at once, and the pool capacity (0 if unlimited)
+
+	int GetAllocatedNodeCount() { return m_AllocateNodeCount; }
+	int GetPeakAllocatedNodeCount() { return m_PeakAllocateNodeCount; }
+	unsigned int GetNodePoolCapacity() { return m_NodePool.GetCapacity(); }
+	unsigned int GetNodePoolReserved() { return m_NodePool.GetReservedCount(); }
+
+	// Bytes held by the node pool, the open and closed lists, the index and the successor buffers
+	size_t GetMemoryUsage()
+	{
+		return m_NodePool.MemoryUsage() + m_OpenList.MemoryUsage() + m_Index.MemoryUsage() +
+			( m_ClosedList.capacity() + m_Successors.capacity() + m_SuccessorExisting.capacity() + m_SearchedNodes.capacity() + m_SolutionPath.capacity() ) * sizeof( Node * ) +
+			m_SuccessorStates.capacity() * sizeof( UserState * ) + m_SuccessorEstimates.capacity() * sizeof( float );
+	}
+
+	// Access to the tracer, for tracers that carry their own settings or output
+	Trace &GetTrace() { return m_Trace; }
+
+	// Counters for the current or last search, all zero unless built with ASTAR_COLLECT_STATS
+	const AStarSearchStats &GetStats() const { return m_Stats; }
+
+
+
+private: // methods
+
+	bool IsOpen( const Node *node ) const
+	{
+		return node->m_List == LIST_OPEN || node->m_List == LIST_FOCAL;
+	}
+
+	// A goal node has been popped. The solution is the chain of parent pointers from the goal, which is ready to read
+	// as it is, so nothing is linked or freed here. The child pointers are only set if the solution is iterated from
+	// the start, and the nodes are freed by FreeSolutionNodes.
+	void Succeed( Node *n, float Bound )
+	{
+		// The user is going to use the Goal Node he passed in so copy the parent pointer of n
+		m_Goal->parent = n->parent;
+		m_Goal->g = n->g;
+
+		SetNodesAside();
+
+		// A special case is that the goal was passed in as the start state so handle that here
+		if( false == n->m_UserState.IsSameState( m_Start->m_UserState ) )
+		{
+			FreeNode( n );
+		}
+		else
+		{
+			m_SearchedNodes.push_back( n ); // the start, which is on neither list now it has been popped
+		}
+
+		m_SolutionHeld = true;
+		m_SolutionLinked = false;
+		m_SolutionBound = Bound;
+		m_State = SEARCH_STATE_SUCCEEDED;
+	}
+
+	// Sets the child pointers along the solution, the first time the solution is iterated from the start
+	void LinkSolution()
+	{
+		if( m_SolutionLinked || m_State != SEARCH_STATE_SUCCEEDED )
+		{
+			return;
+		}
+
+		Node *nodeChild = m_Goal;
+
+		for( Node *nodeParent = m_Goal->parent; nodeParent; nodeParent = nodeParent->parent )
+		{
+			nodeParent->child = nodeChild;
+			nodeChild = nodeParent;
+		}
+
+		m_SolutionLinked = true;
+	}
+
+	void FillResult( SearchResult &Result )
+	{
+		Result.state = m_State;
+		Result.steps = m_Steps;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.bound = m_SolutionBound;
+		Result.path.clear();
+
+		if( m_State == SEARCH_STATE_SUCCEEDED )
+		{
+			for( Node *node = m_Goal; node; node = node->parent )
+			{
+				Result.path.push_back( node->m_UserState );
+			}
+
+			reverse( Result.path.begin(), Result.path.end() );
+		}
+	}
+
+	// Focal search keeps two lazy heaps beside the open list. m_FocalList holds the open nodes whose f is within
+	// m_FocalBound ordered by h, and m_FocalPending the rest ordered by f, so when the smallest f rises the nodes that
+	// come within the bound are at the front of m_FocalPending. Entries are never taken out of the middle, an entry is
+	// just skipped once its node has moved to another list or, while pending, had its f lowered.
+
+	class HeapCompare_h
+	{
+		public:
+
+			bool operator() ( const Node *x, const Node *y ) const
+			{
+				return x->GetH() > y->GetH() || ( x->GetH() == y->GetH() && x->f > y->f );
+			}
+	};
+
+	typedef pair< Cost, Node * > PendingEntry;
+
+	class HeapCompare_pending
+	{
+		public:
+
+			bool operator() ( const PendingEntry &x, const PendingEntry &y ) const
+			{
+				return x.first > y.first;
+			}
+	};
+
+	// Focal search as set by SetSuboptimalBound, except in an anytime search which is weighted A* whatever was set
+	bool IsFocal() const
+	{
+		return m_Focal && !m_Anytime;
+	}
+
+	// A node has gone on the open list or had its f lowered there
+	void Opened( Node *node )
+	{
+		if( !IsFocal() || node->m_List != LIST_OPEN )
+		{
+			return;
+		}
+
+		if( node->f <= m_FocalBound )
+		{
+			node->m_List = LIST_FOCAL;
+			m_FocalList.push_back( node );
+			push_heap( m_FocalList.begin(), m_FocalList.end(), HeapCompare_h() );
+		}
+		else
+		{
+			m_FocalPending.push_back( PendingEntry( node->f, node ) );
+			push_heap( m_FocalPending.begin(), m_FocalPending.end(), HeapCompare_pending() );
+		}
+	}
+
+	// Takes the focal node with the smallest h off the open list
+	Node *PopFocal()
+	{
+		m_FocalBound = (Cost)( m_Weight * m_OpenList.Top()->f );
+
+		while( !m_FocalPending.empty() && m_FocalPending.front().first <= m_FocalBound )
+		{
+			PendingEntry entry = m_FocalPending.front();
+			pop_heap( m_FocalPending.begin(), m_FocalPending.end(), HeapCompare_pending() );
+			m_FocalPending.pop_back();
+
+			if( entry.second->m_List == LIST_OPEN && entry.second->f == entry.first )
+			{
+				Opened( entry.second );
+			}
+		}
+
+		// the node with the smallest f is always within the bound, so one is found
+		while( !m_FocalList.empty() )
+		{
+			Node *node = m_FocalList.front();
+			pop_heap( m_FocalList.begin(), m_FocalList.end(), HeapCompare_h() );
+			m_FocalList.pop_back();
+
+			if( node->m_List != LIST_FOCAL )
+			{
+				continue;
+			}
+
+			if( node->f > m_FocalBound )
+			{
+				// the smallest f has come down, which only an inconsistent heuristic does, so back to waiting
+				node->m_List = LIST_OPEN;
+				Opened( node );
+				continue;
+			}
+
+			m_OpenList.Remove( node );
+			return node;
+		}
+
+		return m_OpenList.Pop();
+	}
+
+	// Starts the next iteration of an anytime search with a lower weight. Nodes reached more cheaply since they were
+	// expanded go back on the open list, the other expanded nodes may be reopened from now on, and the open list is
+	// reordered by the new f.
+	void NextAnytimeIteration()
+	{
+		m_HeuristicWeight = m_AnytimeStep > 0.0f ? max( 1.0f, m_HeuristicWeight - m_AnytimeStep ) : 1.0f;
+
+		for( size_t i = 0; i < m_ClosedList.size(); )
+		{
+			Node *node = m_ClosedList[i];
+
+			if( node->m_List == LIST_INCONSISTENT )
+			{
+				RemoveFromClosedList( node ); // moves the last closed node into slot i
+				m_OpenList.Push( node );
+				node->m_List = LIST_OPEN;
+				ASTAR_STAT( m_Stats.reopened ++ );
+				continue;
+			}
+
+			node->m_List = LIST_CLOSED;
+			i ++;
+		}
+
+		Reweight();
+	}
+
+	// Recomputes f for every open node with the current weight and reorders the open list
+	void Reweight()
+	{
+		for( size_t i = 0; i < m_OpenList.Size(); i ++ )
+		{
+			Node *node = m_OpenList[i];
+			node->f = WeightedF( node );
+		}
+
+		{
+			AStarPhaseTimer timer( m_Stats.heapNanoseconds );
+			m_OpenList.Rebuild();
+		}
+
+		ASTAR_STAT( m_Stats.heapRebuilds ++ );
+	}
+
+	// How far from optimal the anytime solution can be. Every state on an optimal path that hasn't been settled is on
+	// the open list or inconsistent, so the smallest g + h among those is a lower bound on the optimal cost, which can
+	// be tighter than the weight the solution was found with.
+	float AnytimeBound()
+	{
+		Cost lower = numeric_limits< Cost >::max();
+
+		for( size_t i = 0; i < m_OpenList.Size(); i ++ )
+		{
+			lower = min< Cost >( lower, m_OpenList[i]->g + m_OpenList[i]->GetH() );
+		}
+
+		for( size_t i = 0; i < m_ClosedList.size(); i ++ )
+		{
+			if( m_ClosedList[i]->m_List == LIST_INCONSISTENT )
+			{
+				lower = min< Cost >( lower, m_ClosedList[i]->g + m_ClosedList[i]->GetH() );
+			}
+		}
+
+		return lower > 0 ? max( 1.0f, min( m_AnytimeWeight, (float)m_AnytimeGoal->g / (float)lower ) ) : m_AnytimeWeight;
+	}
+
+	// f for the current weight. A weight of 1 adds h as it is, so integer costs stay exact.
+	Cost WeightedF( const Node *node ) const
+	{
+		if( m_HeuristicWeight == 1.0f )
+		{
+			return node->g + node->GetH();
+		}
+
+		return node->g + (Cost)( m_HeuristicWeight * node->GetH() );
+	}
+
+	// Finds the node on the open or closed list holding the same state, NULL if the state has not been seen
+	Node *FindNode( UserState &State )
+	{
+		if( StateIndex< Node >::IsIndexed )
+		{
+			return m_Index.Find( State );
+		}
+
+		for( size_t i = 0; i < m_OpenList.Size(); i ++ )
+		{
+			if( m_OpenList[i]->m_UserState.IsSameState( State ) )
+			{
+				return m_OpenList[i];
+			}
+		}
+
+		typename vector< Node * >::iterator iter;
+
+		for( iter = m_ClosedList.begin(); iter != m_ClosedList.end(); iter ++ )
+		{
+			if( (*iter)->m_UserState.IsSameState( State ) )
+			{
+				return (*iter);
+			}
+		}
+
+		return NULL;
+	}
+
+	// Removes a node from the closed list by moving the last closed node into its slot
+	void RemoveFromClosedList( Node *node )
+	{
+		Node *last = m_ClosedList.back();
+
+		m_ClosedList[ node->m_ListIndex ] = last;
+		last->m_ListIndex = node->m_ListIndex;
+		m_ClosedList.pop_back();
+
+		node->m_List = LIST_NONE;
+	}
+
+	// This is called when a search fails or is canceled to free all used memory
+	void FreeAllNodes()
+	{
+		m_Index.Clear();
+		m_FocalList.clear();
+		m_FocalPending.clear();
+		m_AnytimeGoal = NULL;
+
+		// iterate open list and delete all nodes
+		for( size_t i = 0; i < m_OpenList.Size(); i ++ )
+		{
+			Node *n = m_OpenList[i];
+			FreeNode( n );
+		}
+
+		m_OpenList.Clear();
+
+		// iterate closed list and delete unused nodes
+		typename vector< Node * >::iterator iterClosed;
+
+		for( iterClosed = m_ClosedList.begin(); iterClosed != m_ClosedList.end(); iterClosed ++ )
+		{
+			Node *n = (*iterClosed);
+			FreeNode( n );
+		}
+
+		m_ClosedList.clear();
+
+		// delete the goal
+
+		FreeNode(m_Goal);
+
+		m_Start = m_Goal = NULL;
+		m_CurrentSolutionNode = NULL;
+	}
+
+
+	// This call is made by the search class when the search succeeds. A lot of nodes may be
+	// created that are still present when the search ends. They are moved off the lists into
+	// m_SearchedNodes, which FreeSolutionNodes frees along with the solution
+	void SetNodesAside()
+	{
+		m_Index.Clear();
+		m_FocalList.clear();
+		m_FocalPending.clear();
+		m_AnytimeGoal = NULL;
+
+		// the closed list's nodes are handed over whole, m_SearchedNodes is empty between solutions
+		m_SearchedNodes.swap( m_ClosedList );
+		m_ClosedList.clear();
+
+		for( size_t i = 0; i < m_OpenList.Size(); i ++ )
+		{
+			m_SearchedNodes.push_back( m_OpenList[i] );
+		}
+
+		m_OpenList.Clear();
+	}
+
+	// Node memory management
+	Node *AllocateNode()
+	{
+		Node *p = m_NodePool.Allocate();
+
+		if( p )
+		{
+			m_AllocateNodeCount ++;
+
+			if( m_AllocateNodeCount > m_PeakAllocateNodeCount )
+			{
+				m_PeakAllocateNodeCount = m_AllocateNodeCount;
+			}
+		}
+
+		return p;
+	}
+
+	void FreeNode( Node *node )
+	{
+		m_AllocateNodeCount --;
+		m_NodePool.Free( node );
+	}
+
+private: // data
+
+	// Heap of open nodes, ordered by HeapCompare_f
+	OpenList< Node, HeapCompare_f > m_OpenList;
+
+	// Closed list is a vector.
+	vector< Node * > m_ClosedList;
+
+	// Maps states to the nodes on the open and closed lists
+	StateIndex< Node > m_Index;
+
+	// Successors is a vector filled out by the user each time successors to a node
+	// are generated
+	vector< Node * > m_Successors;
+
+	// The successors' states and their estimates, for a batched heuristic
+	vector< UserState * > m_SuccessorStates;
+	vector< Node * > m_SuccessorExisting;
+	vector< float > m_SuccessorEstimates;
+
+	// A batched heuristic is only asked for when there is an h to fill in
+	enum { BatchedEstimate = AStarBatchEstimate< UserState >::IsBatched && !Heuristic::IsZero };
+
+	// State
+	unsigned int m_State;
+
+	// Counts steps
+	int m_Steps;
+
+	// Counts nodes expanded
+	unsigned int m_NodesExpanded;
+
+	// Set by SetSuboptimalBound, SearchAnytime leaves them alone
+	float m_Weight;
+	bool m_Focal;
+
+	// f is g + m_HeuristicWeight * h, the weight of weighted A* or of the current anytime iteration, otherwise 1
+	float m_HeuristicWeight;
+
+	// Focal search, see Opened and PopFocal
+	vector< Node * > m_FocalList;
+	vector< PendingEntry > m_FocalPending;
+	Cost m_FocalBound;
+
+	// Anytime search
+	bool m_Anytime;
+	float m_AnytimeStep;
+	Node *m_AnytimeGoal; // the best goal node so far, kept on the open list
+	float m_AnytimeWeight; // the weight it was found with
+
+	// What SearchResult::bound reports
+	float m_SolutionBound;
+
+	// After success: the nodes left on the lists, freed with the solution, and whether the child pointers are set
+	vector< Node * > m_SearchedNodes;
+	bool m_SolutionHeld;
+	bool m_SolutionLinked;
+
+	// StreamSolution's way back from the goal
+	vector< Node * > m_SolutionPath;
+
+	// Start and goal state pointers
+	Node *m_Start;
+	Node *m_Goal;
+
+	Node *m_CurrentSolutionNode;
+
+
+
+	//Debug : need to keep these two iterators around for the user Debug functions
+	size_t iterDbgOpen;
+	typename vector< Node * >::iterator iterDbgClosed;
+
+	// Receives trace events, does nothing by default
+	Trace m_Trace;
+
+	// Filled in with ASTAR_COLLECT_STATS
+	AStarSearchStats m_Stats;
+
+	// Node storage, reused across search steps and searches
+	AStarNodePool< Node > m_NodePool;
+
+	// count memory allocation and free's
+	int m_AllocateNodeCount;
+	int m_PeakAllocateNodeCount;
+
+
+};
+
+
+// A* Algorithm Ends ----------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Bidirectional A* Code Starts -----------------------------------------------------------------------------------------------------------------
+
+// Searches forward from the start and backward from the goal at the same time until the two frontiers meet, which
+// expands far fewer nodes than a one way search on long routes. Both directions use the average potential
+//
+//   p(n) = ( n.GoalDistanceEstimate( goal ) - start.GoalDistanceEstimate( n ) ) / 2
+//
+// forward keys are g + p and backward keys are g - p, which keeps both searches consistent, and the search stops once
+// the two smallest keys add up to at least the cost of the best path found. The result is optimal as long as
+// GoalDistanceEstimate is consistent, since start.GoalDistanceEstimate( n ) is then a consistent estimate of the cost
+// from the start to n.
+//
+// On top of the AStarSearch contract the UserState must provide Hash() and
+//
+//   template <class AStarSearchType> bool GetPredecessors( AStarSearchType *astarsearch, UserState *parent_node );
+//
+// which calls astarsearch->AddSuccessor() for every state with an edge into this one. Backward costs are read with
+// predecessor.GetCost( state ), so GetCost must work for states handed out by GetPredecessors.
+
+template <class UserState, template <class, class> class OpenList = AStarBinaryHeap> class AStarBidirectionalSearch
+{
+
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	enum
+	{
+		LIST_NONE,
+		LIST_OPEN,
+		LIST_CLOSED,
+	};
+
+	enum // search directions
+	{
+		FORWARD,
+		BACKWARD,
+	};
+
+	class Node;
+
+	class Label // What one direction of the search knows about a node
+	{
+		public:
+			Node *node; // the node this label belongs to
+			Node *parent; // the neighbour this direction reached the node from
+			float g; // cost from the start (forward) or to the goal (backward)
+			float f; // g plus the potential for this direction, the heap key
+			unsigned int m_List; // LIST_OPEN or LIST_CLOSED once this direction has reached the node
+			unsigned int m_ListIndex; // position in this direction's open heap
+			Label() :
+				node( 0 ),
+				parent( 0 ),
+				g( FLT_MAX ),
+				f( FLT_MAX ),
+				m_List( LIST_NONE ),
+				m_ListIndex( 0 )
+			{}
+	};
+
+	class Node // A state reached by either direction of the search
+	{
+		public:
+			Label m_Label[2]; // FORWARD and BACKWARD
+			float p; // forward potential, the backward potential is -p
+			Node *child; // used after the search for the application to view the search in reverse
+			Node() :
+				p( 0.0f ),
+				child( 0 )
+			{
+				m_Label[FORWARD].node = this;
+				m_Label[BACKWARD].node = this;
+			}
+			UserState m_UserState;
+	};
+
+	class HeapCompare_f
+	{
+		public:
+
+			bool operator() ( const Label *x, const Label *y ) const
+			{
+				return x->f > y->f;
+			}
+	};
+
+	class SearchResult // Outcome of a one-shot Search()
+	{
+		public:
+
+			unsigned int state;
+			vector< UserState > path;
+			float cost;
+			unsigned int steps;
+			unsigned int nodesExpanded;
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( FLT_MAX ),
+				steps( 0 ),
+				nodesExpanded( 0 )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef UserState UserStateType;
+
+
+public: // methods
+
+
+	// MaxNodes caps how many nodes the search may hold at once, 0 lets the node pool grow as needed
+	AStarBidirectionalSearch( unsigned int MaxNodes = 0 ) :
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Steps( 0 ),
+		m_NodesExpanded( 0 ),
+		m_Start( NULL ),
+		m_Goal( NULL ),
+		m_Meeting( NULL ),
+		m_BestCost( FLT_MAX ),
+		m_CurrentSolutionNode( NULL ),
+		m_NodePool( MaxNodes ),
+		m_AllocateNodeCount( 0 )
+	{
+	}
+
+	// Set Start and goal states, this frees whatever the last search left, solution included
+	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	{
+		FreeAllNodes();
+
+		m_Steps = 0;
+		m_NodesExpanded = 0;
+		m_BestCost = FLT_MAX;
+		m_Meeting = NULL;
+		m_StartState = Start;
+		m_GoalState = Goal;
+		m_State = SEARCH_STATE_SEARCHING;
+
+		m_Start = GetNode( Start );
+		m_Goal = m_Start ? GetNode( Goal ) : NULL;
+
+		if( !m_Start || !m_Goal )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return;
+		}
+
+		Reach( FORWARD, m_Start, NULL, 0.0f );
+		Reach( BACKWARD, m_Goal, NULL, 0.0f );
+	}
+
+	// Advances search one step, each step expands one node in one direction
+	unsigned int SearchStep()
+	{
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			return m_State;
+		}
+
+		// An empty open list means that direction has seen everything it can reach, so either the best meeting
+		// found is the shortest path or there is no path at all
+		if( m_OpenList[FORWARD].Empty() || m_OpenList[BACKWARD].Empty() ||
+			m_OpenList[FORWARD].Top()->f + m_OpenList[BACKWARD].Top()->f >= m_BestCost )
+		{
+			if( m_Meeting )
+			{
+				LinkSolution();
+				m_State = SEARCH_STATE_SUCCEEDED;
+			}
+			else
+			{
+				FreeAllNodes();
+				m_State = SEARCH_STATE_FAILED;
+			}
+
+			return m_State;
+		}
+
+		m_Steps ++;
+
+		// expand the smaller frontier, that keeps the two searches about the same size
+		unsigned int dir = m_OpenList[BACKWARD].Size() < m_OpenList[FORWARD].Size() ? BACKWARD : FORWARD;
+
+		Label *label = m_OpenList[dir].Pop();
+		Node *n = label->node;
+
+		label->m_List = LIST_CLOSED;
+
+		m_Successors.clear();
+
+		Node *from = label->parent;
+		bool ret;
+
+		if( dir == FORWARD )
+		{
+			ret = n->m_UserState.GetSuccessors( this, from ? &from->m_UserState : NULL );
+		}
+		else
+		{
+			ret = n->m_UserState.GetPredecessors( this, from ? &from->m_UserState : NULL );
+		}
+
+		if( !ret )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return m_State;
+		}
+
+		m_NodesExpanded ++;
+
+		for( typename vector< UserState >::iterator successor = m_Successors.begin(); successor != m_Successors.end(); successor ++ )
+		{
+			float cost = dir == FORWARD ? n->m_UserState.GetCost( *successor ) : successor->GetCost( n->m_UserState );
+
+			Node *neighbour = GetNode( *successor );
+
+			if( !neighbour )
+			{
+				FreeAllNodes();
+				m_State = SEARCH_STATE_OUT_OF_MEMORY;
+				return m_State;
+			}
+
+			Reach( dir, neighbour, n, label->g + cost );
+		}
+
+		return m_State;
+	}
+
+	// Runs the search until it ends or the budget runs out, see AStarSearch::Search
+	unsigned int Search( SearchResult &Result, unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64;
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( MaxSteps && stepsTaken >= MaxSteps )
+			{
+				break;
+			}
+
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		Result.state = m_State;
+		Result.steps = m_Steps;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.path.clear();
+
+		if( m_State == SEARCH_STATE_SUCCEEDED )
+		{
+			for( Node *node = m_Start; node; node = node->child )
+			{
+				Result.path.push_back( node->m_UserState );
+			}
+		}
+
+		return m_State;
+	}
+
+	SearchResult Search( unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, MaxSteps, Deadline );
+		return result;
+	}
+
+	// Abandons a search that is still running and frees all of its nodes
+	void CancelSearch()
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// User calls this from GetSuccessors and GetPredecessors for each neighbouring state
+	bool AddSuccessor( UserState &State )
+	{
+		m_Successors.push_back( State );
+		return true;
+	}
+
+	// Free the nodes of the solution once it has been used
+	void FreeSolutionNodes()
+	{
+		FreeAllNodes();
+	}
+
+	// Functions for traversing the solution, as for AStarSearch
+
+	UserState *GetSolutionStart()
+	{
+		m_CurrentSolutionNode = m_Start;
+		return m_Start ? &m_Start->m_UserState : NULL;
+	}
+
+	UserState *GetSolutionNext()
+	{
+		if( m_CurrentSolutionNode && m_CurrentSolutionNode->child )
+		{
+			m_CurrentSolutionNode = m_CurrentSolutionNode->child;
+			return &m_CurrentSolutionNode->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	UserState *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Goal;
+		return m_Goal ? &m_Goal->m_UserState : NULL;
+	}
+
+	UserState *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode && m_CurrentSolutionNode->m_Label[FORWARD].parent && m_CurrentSolutionNode != m_Start )
+		{
+			m_CurrentSolutionNode = m_CurrentSolutionNode->m_Label[FORWARD].parent;
+			return &m_CurrentSolutionNode->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution, FLT_MAX if there is none
+	float GetSolutionCost()
+	{
+		return m_State == SEARCH_STATE_SUCCEEDED ? m_BestCost : FLT_MAX;
+	}
+
+	int GetStepCount() { return m_Steps; }
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+	int GetAllocatedNodeCount() { return m_AllocateNodeCount; }
+
+private: // methods
+
+	// Finds the node for a state, creating it with its potential if the search has not seen the state before
+	Node *GetNode( UserState &State )
+	{
+		Node *node = m_Index.Find( State );
+
+		if( node )
+		{
+			return node;
+		}
+
+		node = m_NodePool.Allocate();
+
+		if( !node )
+		{
+			return NULL;
+		}
+
+		m_AllocateNodeCount ++;
+
+		node->m_UserState = State;
+		node->p = ( node->m_UserState.GoalDistanceEstimate( m_GoalState ) - m_StartState.GoalDistanceEstimate( node->m_UserState ) ) * 0.5f;
+
+		m_Index.Insert( node );
+		m_Nodes.push_back( node );
+
+		return node;
+	}
+
+	// Direction dir reached node from parent with cost g, keep it if that is cheaper than what it had
+	void Reach( unsigned int dir, Node *node, Node *parent, float g )
+	{
+		Label &label = node->m_Label[dir];
+
+		if( g >= label.g )
+		{
+			return;
+		}
+
+		label.parent = parent;
+		label.g = g;
+		label.f = dir == FORWARD ? g + node->p : g - node->p;
+
+		if( label.m_List == LIST_OPEN )
+		{
+			m_OpenList[dir].Update( &label );
+		}
+		else
+		{
+			// new, or closed and reached more cheaply, which consistent potentials should never allow
+			label.m_List = LIST_OPEN;
+			m_OpenList[dir].Push( &label );
+		}
+
+		// a node both directions have reached joins a path from start to goal
+		float other = node->m_Label[1 - dir].g;
+
+		if( other != FLT_MAX && g + other < m_BestCost )
+		{
+			m_BestCost = g + other;
+			m_Meeting = node;
+		}
+	}
+
+	// Sets the child pointers from the start to the meeting node, then on to the goal
+	void LinkSolution()
+	{
+		Node *child = m_Meeting;
+
+		for( Node *node = m_Meeting->m_Label[FORWARD].parent; node; node = node->m_Label[FORWARD].parent )
+		{
+			node->child = child;
+			child = node;
+		}
+
+		for( Node *node = m_Meeting; node != m_Goal; node = node->child )
+		{
+			node->child = node->m_Label[BACKWARD].parent;
+
+			// the path goes forward from here on, make GetSolutionPrev follow it
+			node->child->m_Label[FORWARD].parent = node;
+		}
+
+		m_Goal->child = NULL;
+	}
+
+	void FreeAllNodes()
+	{
+		for( size_t i = 0; i < m_Nodes.size(); i ++ )
+		{
+			m_NodePool.Free( m_Nodes[i] );
+		}
+
+		m_AllocateNodeCount -= (int)m_Nodes.size();
+
+		m_Nodes.clear();
+		m_Index.Clear();
+		m_OpenList[FORWARD].Clear();
+		m_OpenList[BACKWARD].Clear();
+
+		m_Start = m_Goal = m_Meeting = NULL;
+		m_CurrentSolutionNode = NULL;
+	}
+
+private: // data
+
+	// Open heap for each direction
+	OpenList< Label, HeapCompare_f > m_OpenList[2];
+
+	// Every node the search has created, and the index to find them by state
+	vector< Node * > m_Nodes;
+	AStarHashIndex< Node > m_Index;
+
+	// Filled out by the user each time the neighbours of a node are generated
+	vector< UserState > m_Successors;
+
+	unsigned int m_State;
+	int m_Steps;
+	unsigned int m_NodesExpanded;
+
+	UserState m_StartState;
+	UserState m_GoalState;
+	Node *m_Start;
+	Node *m_Goal;
+
+	// The node where the best path found so far crosses from the forward search into the backward search
+	Node *m_Meeting;
+	float m_BestCost;
+
+	Node *m_CurrentSolutionNode;
+
+	AStarNodePool< Node > m_NodePool;
+	int m_AllocateNodeCount;
+};
+
+// Bidirectional A* Ends ------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Compact A* Code Starts -----------------------------------------------------------------------------------------------------------------------
+
+// Node store policies. A store holds the compact search's nodes as parallel arrays indexed by node number and finds
+// the node for a state. Find returns NO_NODE for a state the current search has not reached, Add makes a node for
+// such a state and only sets its state, Clear lets go of every node ready for the next search.
+
+template <class UserState> class AStarHashedNodes // Nodes numbered in the order they are reached and found through a hash index on UserState::Hash()
+{
+public:
+
+	enum { NO_NODE = 0xffffffff };
+
+	AStarHashedNodes() :
+		m_IndexCount( 0 ),
+		m_IndexShift( 0 )
+	{
+	}
+
+	unsigned int Find( UserState &State )
+	{
+		if( m_IndexCount == 0 )
+		{
+			return NO_NODE;
+		}
+
+		unsigned int hash = FoldHash( State.Hash() );
+		size_t mask = m_IndexSlots.size() - 1;
+
+		for( size_t slot = Bucket( hash ); m_IndexSlots[slot].node != NO_NODE; slot = (slot + 1) & mask )
+		{
+			if( m_IndexSlots[slot].hash == hash && m_States[ m_IndexSlots[slot].node ].IsSameState( State ) )
+			{
+				return m_IndexSlots[slot].node;
+			}
+		}
+
+		return NO_NODE;
+	}
+
+	unsigned int Add( UserState &State )
+	{
+		unsigned int node = (unsigned int)m_States.size();
+
+		m_States.push_back( State );
+		m_G.push_back( 0.0f );
+		m_H.push_back( 0.0f );
+		m_Parent.push_back( NO_NODE );
+		m_HeapPos.push_back( NO_NODE );
+
+		if( (m_IndexCount + 1) * 2 > m_IndexSlots.size() )
+		{
+			Grow();
+		}
+
+		Place( node, FoldHash( State.Hash() ) );
+		m_IndexCount ++;
+
+		return node;
+	}
+
+	void Clear()
+	{
+		m_States.clear();
+		m_G.clear();
+		m_H.clear();
+		m_Parent.clear();
+		m_HeapPos.clear();
+
+		if( m_IndexCount )
+		{
+			fill( m_IndexSlots.begin(), m_IndexSlots.end(), IndexSlot() );
+			m_IndexCount = 0;
+		}
+	}
+
+	void Reserve( unsigned int Count )
+	{
+		m_States.reserve( Count );
+		m_G.reserve( Count );
+		m_H.reserve( Count );
+		m_Parent.reserve( Count );
+		m_HeapPos.reserve( Count );
+
+		while( (size_t)Count * 2 > m_IndexSlots.size() )
+		{
+			Grow();
+		}
+	}
+
+	unsigned int Count() const { return (unsigned int)m_States.size(); }
+
+	size_t MemoryUsage() const
+	{
+		return m_States.capacity() * sizeof( UserState ) +
+			( m_G.capacity() + m_H.capacity() ) * sizeof( float ) +
+			( m_Parent.capacity() + m_HeapPos.capacity() ) * sizeof( unsigned int ) +
+			m_IndexSlots.capacity() * sizeof( IndexSlot );
+	}
+
+	// Node arrays, all indexed by node
+	vector< UserState > m_States;
+	vector< float > m_G;
+	vector< float > m_H;
+	vector< unsigned int > m_Parent;
+	vector< unsigned int > m_HeapPos;
+
+private:
+
+	// Open addressing on node numbers, each slot keeping 32 bits of the hash so most probes that miss never touch
+	// m_States. Nodes are only let go all at once so there is no deletion.
+	class IndexSlot
+	{
+		public:
+			unsigned int node;
+			unsigned int hash;
+			IndexSlot() :
+				node( NO_NODE ),
+				hash( 0 )
+			{}
+	};
+
+	static unsigned int FoldHash( size_t hash )
+	{
+		return (unsigned int)( (unsigned long long)hash ^ ( (unsigned long long)hash >> 32 ) );
+	}
+
+	size_t Bucket( unsigned int hash ) const
+	{
+		// Fibonacci hashing spreads out user hashes that are just small integers
+		return (size_t)( ((unsigned long long)hash * 0x9E3779B97F4A7C15ULL) >> m_IndexShift );
+	}
+
+	void Place( unsigned int node, unsigned int hash )
+	{
+		size_t mask = m_IndexSlots.size() - 1;
+		size_t slot = Bucket( hash );
+
+		while( m_IndexSlots[slot].node != NO_NODE )
+		{
+			slot = (slot + 1) & mask;
+		}
+
+		m_IndexSlots[slot].node = node;
+		m_IndexSlots[slot].hash = hash;
+	}
+
+	void Grow()
+	{
+		vector< IndexSlot > oldSlots;
+
+		oldSlots.swap( m_IndexSlots );
+
+		size_t bits = 4;
+
+		while( ((size_t)1 << bits) < oldSlots.size() * 2 )
+		{
+			bits ++;
+		}
+
+		m_IndexSlots.assign( (size_t)1 << bits, IndexSlot() );
+		m_IndexShift = 64 - (unsigned int)bits;
+
+		for( size_t i = 0; i < oldSlots.size(); i ++ )
+		{
+			if( oldSlots[i].node != NO_NODE )
+			{
+				Place( oldSlots[i].node, oldSlots[i].hash );
+			}
+		}
+	}
+
+	vector< IndexSlot > m_IndexSlots;
+	size_t m_IndexCount;
+	unsigned int m_IndexShift;
+};
+
+// One node per vertex for states numbered 0 .. V - 1 by UserState::Id(), such as the nodes of a CSRGraph. The node
+// number is the vertex number so there is no index to search or clear. Each slot is stamped with the generation of
+// the search that last reached it and Clear just starts a new generation, so after the first search on a graph
+// (or ReserveNodes with the vertex count) starting a search costs O(1) and back to back searches never allocate.
+// The arrays take O(V) memory however few vertices a search reaches.
+
+template <class UserState> class AStarVertexNodes
+{
+public:
+
+	enum { NO_NODE = 0xffffffff };
+
+	AStarVertexNodes() :
+		m_Generation( 1 ),
+		m_Count( 0 )
+	{
+	}
+
+	unsigned int Find( UserState &State )
+	{
+		unsigned int id = State.Id();
+
+		return id < m_Stamp.size() && m_Stamp[id] == m_Generation ? id : (unsigned int)NO_NODE;
+	}
+
+	unsigned int Add( UserState &State )
+	{
+		unsigned int id = State.Id();
+
+		if( id >= m_Stamp.size() )
+		{
+			Reserve( max( id + 1, (unsigned int)m_Stamp.size() * 2 ) );
+		}
+
+		m_Stamp[id] = m_Generation;
+		m_States[id] = State;
+		m_Count ++;
+
+		return id;
+	}
+
+	void Clear()
+	{
+		m_Count = 0;
+		m_Generation ++;
+
+		if( m_Generation == 0 )
+		{
+			// the stamps have wrapped round, this happens once every 2^32 searches
+			fill( m_Stamp.begin(), m_Stamp.end(), 0u );
+			m_Generation = 1;
+		}
+	}
+
+	// Count is the number of vertices, the largest Id() plus one
+	void Reserve( unsigned int Count )
+	{
+		if( Count > m_Stamp.size() )
+		{
+			m_States.resize( Count );
+			m_G.resize( Count );
+			m_H.resize( Count );
+			m_Parent.resize( Count );
+			m_HeapPos.resize( Count );
+			m_Stamp.resize( Count, 0u );
+		}
+	}
+
+	unsigned int Count() const { return m_Count; }
+
+	size_t MemoryUsage() const
+	{
+		return m_States.capacity() * sizeof( UserState ) +
+			( m_G.capacity() + m_H.capacity() ) * sizeof( float ) +
+			( m_Parent.capacity() + m_HeapPos.capacity() + m_Stamp.capacity() ) * sizeof( unsigned int );
+	}
+
+	// Node arrays, all indexed by vertex
+	vector< UserState > m_States;
+	vector< float > m_G;
+	vector< float > m_H;
+	vector< unsigned int > m_Parent;
+	vector< unsigned int > m_HeapPos;
+
+private:
+
+	vector< unsigned int > m_Stamp; // the generation that last reached each vertex
+	unsigned int m_Generation;
+	unsigned int m_Count;
+};
+
+// The same search as AStarSearch with its nodes held as structure of arrays. A node is a 32 bit index into arrays of
+// states, g, h and parent indices instead of a separately allocated Node with parent and child pointers, and the open
+// heap holds (f, node) pairs so ordering the heap never reads a node. A node takes about half the memory of an
+// AStarSearch node with a hash index, which matters once a search holds millions of them.
+//
+// NodeStore decides how nodes are numbered and found. With the default AStarHashedNodes the UserState must provide
+// Hash() on top of the AStarSearch contract, states that are IsSameState must return the same Hash(). With
+// AStarVertexNodes it must provide Id() instead. Nodes are only let go between searches, so a search holds at most
+// 2^32 - 1 nodes.
+
+template <class UserState, template <class> class NodeStore = AStarHashedNodes> class AStarCompactSearch
+{
+
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	enum { NO_NODE = 0xffffffff }; // not a node, the parent of the start and the heap position of a closed node
+
+	class HeapEntry // An open node with its f, kept together so the heap is ordered without touching the node arrays
+	{
+		public:
+			float f;
+			unsigned int node;
+	};
+
+	class SearchResult // Outcome of a one-shot Search()
+	{
+		public:
+
+			unsigned int state;
+			vector< UserState > path;
+			float cost;
+			unsigned int steps;
+			unsigned int nodesExpanded;
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( FLT_MAX ),
+				steps( 0 ),
+				nodesExpanded( 0 )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef UserState UserStateType;
+
+
+public: // methods
+
+
+	// MaxNodes caps how many nodes the search may hold at once, 0 for no cap
+	AStarCompactSearch( unsigned int MaxNodes = 0 ) :
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Steps( 0 ),
+		m_NodesExpanded( 0 ),
+		m_MaxNodes( MaxNodes ? MaxNodes : (unsigned int)NO_NODE ),
+		m_PeakNodeCount( 0 ),
+		m_SolutionCost( FLT_MAX ),
+		m_CurrentSolutionNode( 0 )
+	{
+	}
+
+	// Pre-allocates the arrays for Count nodes so the first searches don't need to grow them. For AStarVertexNodes
+	// Count is the number of vertices.
+	void ReserveNodes( unsigned int Count )
+	{
+		m_Nodes.Reserve( Count );
+	}
+
+	// Set Start and goal states
+	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	{
+		FreeAllNodes();
+
+		m_Steps = 0;
+		m_NodesExpanded = 0;
+		m_GoalState = Goal;
+		m_State = SEARCH_STATE_SEARCHING;
+
+		if( AddNode( Start, NO_NODE, 0.0f ) == NO_NODE )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+		}
+	}
+
+	// Advances search one step
+	unsigned int SearchStep()
+	{
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			return m_State;
+		}
+
+		// Failure is defined as emptying the open list as there is nothing left to search
+		if( m_Heap.empty() )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+			return m_State;
+		}
+
+		m_Steps ++;
+
+		unsigned int n = HeapPop();
+
+		if( m_Nodes.m_States[n].IsGoal( m_GoalState ) )
+		{
+			// walk the parents back to the start, then turn the path around
+			for( unsigned int node = n; node != NO_NODE; node = m_Nodes.m_Parent[node] )
+			{
+				m_Solution.push_back( node );
+			}
+
+			reverse( m_Solution.begin(), m_Solution.end() );
+
+			m_SolutionCost = m_Nodes.m_G[n];
+			m_State = SEARCH_STATE_SUCCEEDED;
+			return m_State;
+		}
+
+		m_Successors.clear();
+
+		// the arrays don't move while the successors are generated, AddSuccessor only fills m_Successors
+		unsigned int parent = m_Nodes.m_Parent[n];
+		bool ret = m_Nodes.m_States[n].GetSuccessors( this, parent != NO_NODE ? &m_Nodes.m_States[parent] : NULL );
+
+		if( !ret )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return m_State;
+		}
+
+		m_NodesExpanded ++;
+
+		for( size_t i = 0; i < m_Successors.size(); i ++ )
+		{
+			// the node arrays may be reallocated by AddNode, so n's state is looked up afresh each time
+			float newg = m_Nodes.m_G[n] + m_Nodes.m_States[n].GetCost( m_Successors[i] );
+
+			unsigned int existing = m_Nodes.Find( m_Successors[i] );
+
+			if( existing == NO_NODE )
+			{
+				if( AddNode( m_Successors[i], n, newg ) == NO_NODE )
+				{
+					FreeAllNodes();
+					m_State = SEARCH_STATE_OUT_OF_MEMORY;
+					return m_State;
+				}
+
+				continue;
+			}
+
+			if( m_Nodes.m_G[existing] <= newg )
+			{
+				continue; // the one on Open or Closed is cheaper than this one
+			}
+
+			m_Nodes.m_G[existing] = newg;
+			m_Nodes.m_Parent[existing] = n;
+
+			float f = newg + m_Nodes.m_H[existing];
+
+			if( m_Nodes.m_HeapPos[existing] == NO_NODE )
+			{
+				HeapPush( existing, f ); // closed, reopen it
+			}
+			else
+			{
+				// lower f so sift it up, the rest of the heap is untouched
+				m_Heap[ m_Nodes.m_HeapPos[existing] ].f = f;
+				SiftUp( m_Nodes.m_HeapPos[existing] );
+			}
+		}
+
+		return m_State;
+	}
+
+	// Runs the search until it ends or the budget runs out, see AStarSearch::Search
+	unsigned int Search( SearchResult &Result, unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64;
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( MaxSteps && stepsTaken >= MaxSteps )
+			{
+				break;
+			}
+
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		Result.state = m_State;
+		Result.steps = m_Steps;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.path.clear();
+
+		for( size_t i = 0; i < m_Solution.size(); i ++ )
+		{
+			Result.path.push_back( m_Nodes.m_States[ m_Solution[i] ] );
+		}
+
+		return m_State;
+	}
+
+	SearchResult Search( unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, MaxSteps, Deadline );
+		return result;
+	}
+
+	// Abandons a search that is still running and lets go of all of its nodes
+	void CancelSearch()
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// User calls this to add a successor to a list of successors when expanding the search frontier
+	bool AddSuccessor( UserState &State )
+	{
+		m_Successors.push_back( State );
+		return true;
+	}
+
+	// Lets go of the nodes once the solution has been used. The arrays keep their memory for the next search.
+	void FreeSolutionNodes()
+	{
+		FreeAllNodes();
+	}
+
+	// Functions for traversing the solution, as for AStarSearch
+
+	UserState *GetSolutionStart()
+	{
+		m_CurrentSolutionNode = 0;
+		return m_Solution.empty() ? NULL : &m_Nodes.m_States[ m_Solution[0] ];
+	}
+
+	UserState *GetSolutionNext()
+	{
+		if( m_CurrentSolutionNode + 1 < m_Solution.size() )
+		{
+			m_CurrentSolutionNode ++;
+			return &m_Nodes.m_States[ m_Solution[ m_CurrentSolutionNode ] ];
+		}
+
+		return NULL;
+	}
+
+	UserState *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Solution.empty() ? 0 : m_Solution.size() - 1;
+		return m_Solution.empty() ? NULL : &m_Nodes.m_States[ m_Solution.back() ];
+	}
+
+	UserState *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode > 0 && m_CurrentSolutionNode < m_Solution.size() )
+		{
+			m_CurrentSolutionNode --;
+			return &m_Nodes.m_States[ m_Solution[ m_CurrentSolutionNode ] ];
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution, FLT_MAX if there is none
+	float GetSolutionCost()
+	{
+		return m_State == SEARCH_STATE_SUCCEEDED ? m_SolutionCost : FLT_MAX;
+	}
+
+	int GetStepCount() { return m_Steps; }
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+	int GetAllocatedNodeCount() { return (int)m_Nodes.Count(); }
+	int GetPeakAllocatedNodeCount() { return (int)m_PeakNodeCount; }
+
+	// Bytes held by the node store and the open heap
+	size_t GetMemoryUsage()
+	{
+		return m_Nodes.MemoryUsage() + m_Heap.capacity() * sizeof( HeapEntry );
+	}
+
+private: // methods
+
+	// Adds a node for a state the search has not seen, opens it and returns its index, NO_NODE when the node cap is hit
+	unsigned int AddNode( UserState &State, unsigned int Parent, float g )
+	{
+		if( m_Nodes.Count() >= m_MaxNodes )
+		{
+			return NO_NODE;
+		}
+
+		float h = State.GoalDistanceEstimate( m_GoalState );
+		unsigned int node = m_Nodes.Add( State );
+
+		m_Nodes.m_G[node] = g;
+		m_Nodes.m_H[node] = h;
+		m_Nodes.m_Parent[node] = Parent;
+
+		m_PeakNodeCount = max( m_PeakNodeCount, m_Nodes.Count() );
+
+		HeapPush( node, g + h );
+
+		return node;
+	}
+
+	void FreeAllNodes()
+	{
+		m_Nodes.Clear();
+		m_Heap.clear();
+		m_Solution.clear();
+		m_CurrentSolutionNode = 0;
+	}
+
+	// Open heap, a binary heap on f. m_HeapPos tracks where each open node is so its f can be lowered in place.
+
+	void HeapPush( unsigned int node, float f )
+	{
+		HeapEntry entry;
+		entry.f = f;
+		entry.node = node;
+
+		m_Heap.push_back( entry );
+		SiftUp( m_Heap.size() - 1 );
+	}
+
+	unsigned int HeapPop()
+	{
+		unsigned int top = m_Heap[0].node;
+		HeapEntry last = m_Heap.back();
+
+		m_Heap.pop_back();
+		m_Nodes.m_HeapPos[top] = NO_NODE;
+
+		if( !m_Heap.empty() )
+		{
+			m_Heap[0] = last;
+			SiftDown( 0 );
+		}
+
+		return top;
+	}
+
+	void SiftUp( size_t pos )
+	{
+		HeapEntry entry = m_Heap[pos];
+
+		while( pos > 0 )
+		{
+			size_t parent = (pos - 1) / 2;
+
+			if( m_Heap[parent].f <= entry.f )
+			{
+				break;
+			}
+
+			m_Heap[pos] = m_Heap[parent];
+			m_Nodes.m_HeapPos[ m_Heap[pos].node ] = (unsigned int)pos;
+			pos = parent;
+		}
+
+		m_Heap[pos] = entry;
+		m_Nodes.m_HeapPos[ entry.node ] = (unsigned int)pos;
+	}
+
+	void SiftDown( size_t pos )
+	{
+		HeapEntry entry = m_Heap[pos];
+		size_t size = m_Heap.size();
+
+		for( ;; )
+		{
+			size_t child = pos * 2 + 1;
+
+			if( child >= size )
+			{
+				break;
+			}
+
+			if( child + 1 < size && m_Heap[child + 1].f < m_Heap[child].f )
+			{
+				child ++;
+			}
+
+			if( entry.f <= m_Heap[child].f )
+			{
+				break;
+			}
+
+			m_Heap[pos] = m_Heap[child];
+			m_Nodes.m_HeapPos[ m_Heap[pos].node ] = (unsigned int)pos;
+			pos = child;
+		}
+
+		m_Heap[pos] = entry;
+		m_Nodes.m_HeapPos[ entry.node ] = (unsigned int)pos;
+	}
+
+private: // data
+
+	// The nodes. m_H is kept so a closed node that is reached more cheaply can be reopened without a new estimate,
+	// m_HeapPos is the node's position in m_Heap, NO_NODE once it is closed.
+	NodeStore< UserState > m_Nodes;
+
+	vector< HeapEntry > m_Heap;
+
+	// Filled out by the user each time successors to a node are generated
+	vector< UserState > m_Successors;
+
+	unsigned int m_State;
+	int m_Steps;
+	unsigned int m_NodesExpanded;
+	unsigned int m_MaxNodes;
+	unsigned int m_PeakNodeCount;
+
+	UserState m_GoalState;
+
+	// The solution's nodes from start to goal
+	vector< unsigned int > m_Solution;
+	float m_SolutionCost;
+	size_t m_CurrentSolutionNode;
+};
+
+// Compact A* Ends ------------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Incremental A* Code Starts -------------------------------------------------------------------------------------------------------------------
+
+// Lifelong Planning A* (LPA*, Koenig and Likhachev). Plans like AStarSearch between a fixed start and goal, but keeps
+// its search tree after it finishes so that when edge costs change the previous solution is repaired instead of
+// searched for again. Each node keeps its g and a one step lookahead
+//
+//   rhs(n) = min over predecessors p of g(p) + p.GetCost( n )
+//
+// and only nodes where the two differ (locally inconsistent) are queued, ordered on [ min(g, rhs) + h, min(g, rhs) ].
+// After a change only the nodes whose cost to reach actually changed are expanded again.
+//
+// Costs must not be negative but may be 0. LPA* relies on every edge adding to the cost, so each cost carries the
+// number of edges taken to reach it and equal costs are told apart by that count. Without it a group of nodes joined
+// by 0 cost edges could keep each other's old cost alive after the way into the group got dearer.
+//
+// To replan, change the costs (so that GetCost returns the new values), call UpdateEdge for every edge that changed
+// and run Search or SearchStep again. Any number of updates can be batched before the repair. Both raised and lowered
+// costs are handled, and a search that failed can succeed after a repair that opens up a path.
+//
+// On top of the AStarSearch contract the UserState must provide Hash() and GetPredecessors, as for
+// AStarBidirectionalSearch, which is used to work out rhs again when the edge a node was reached through gets dearer.
+
+template <class UserState, template <class, class> class OpenList = AStarBinaryHeap> class AStarLPASearch
+{
+
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	class Node
+	{
+		public:
+			Node *parent; // the predecessor rhs comes from
+			Node *child; // used after the search for the application to view the search in reverse
+			float g; // cost from the start as of the last expansion, FLT_MAX if unknown
+			float rhs; // cost from the start through the best predecessor
+			float h; // heuristic estimate of distance to goal
+			float k1, k2; // queue key, [ min(g, rhs) + h, min(g, rhs) ]
+			unsigned int gSteps, rhsSteps, kSteps; // edges taken for g, rhs and the key, 0 while the cost is FLT_MAX
+			bool m_Queued; // on the open list
+			unsigned int m_ListIndex; // position in the open heap
+			unsigned int m_Stamp; // LinkSolution's mark
+			Node() :
+				parent( 0 ),
+				child( 0 ),
+				g( FLT_MAX ),
+				rhs( FLT_MAX ),
+				h( 0.0f ),
+				k1( FLT_MAX ),
+				k2( FLT_MAX ),
+				gSteps( 0 ),
+				rhsSteps( 0 ),
+				kSteps( 0 ),
+				m_Queued( false ),
+				m_ListIndex( 0 ),
+				m_Stamp( 0 )
+			{}
+			UserState m_UserState;
+	};
+
+	class HeapCompare_k // Orders nodes by key, comparing k1, the steps, then k2
+	{
+		public:
+
+			bool operator() ( const Node *x, const Node *y ) const
+			{
+				return KeyLess( y->k1, y->kSteps, y->k2, x->k1, x->kSteps, x->k2 );
+			}
+	};
+
+	class SearchResult // Outcome of a one-shot Search()
+	{
+		public:
+
+			unsigned int state;
+			vector< UserState > path;
+			float cost;
+			unsigned int steps; // steps since the search was set up or last repaired
+			unsigned int nodesExpanded; // nodes expanded since the search was set up or last repaired
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( FLT_MAX ),
+				steps( 0 ),
+				nodesExpanded( 0 )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef UserState UserStateType;
+
+
+public: // methods
+
+
+	// MaxNodes caps how many nodes the search may hold at once, 0 lets the node pool grow as needed
+	AStarLPASearch( unsigned int MaxNodes = 0 ) :
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Steps( 0 ),
+		m_NodesExpanded( 0 ),
+		m_Start( NULL ),
+		m_Goal( NULL ),
+		m_CurrentSolutionNode( NULL ),
+		m_Stamp( 0 ),
+		m_NodePool( MaxNodes ),
+		m_AllocateNodeCount( 0 )
+	{
+	}
+
+	~AStarLPASearch()
+	{
+		FreeAllNodes();
+	}
+
+	// Set Start and goal states, this throws away anything planned before
+	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	{
+		FreeAllNodes();
+
+		m_Steps = 0;
+		m_NodesExpanded = 0;
+		m_GoalState = Goal;
+		m_State = SEARCH_STATE_SEARCHING;
+
+		m_Start = GetNode( Start );
+		m_Goal = m_Start ? GetNode( Goal ) : NULL;
+
+		if( !m_Start || !m_Goal )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return;
+		}
+
+		m_Start->rhs = 0.0f;
+		m_Start->rhsSteps = 0;
+		UpdateNode( m_Start );
+	}
+
+	// Advances search one step
+	unsigned int SearchStep()
+	{
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			return m_State;
+		}
+
+		// Done once nothing queued could lower the goal's cost and the goal itself is consistent
+		if( m_OpenList.Empty() || ( !QueuedBefore( m_OpenList.Top(), m_Goal ) && IsConsistent( m_Goal ) ) )
+		{
+			if( m_Goal->g != FLT_MAX && LinkSolution() )
+			{
+				m_State = SEARCH_STATE_SUCCEEDED;
+			}
+			else
+			{
+				// the search tree is kept, a later repair may still find a way
+				m_State = SEARCH_STATE_FAILED;
+			}
+
+			return m_State;
+		}
+
+		m_Steps ++;
+
+		Node *n = m_OpenList.Pop();
+		n->m_Queued = false;
+
+		if( !GetSuccessorNodes( n ) )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return m_State;
+		}
+
+		m_NodesExpanded ++;
+
+		if( CostLess( n->rhs, n->rhsSteps, n->g, n->gSteps ) )
+		{
+			// overconsistent, its cost has come down so pass the saving on to the successors
+			n->g = n->rhs;
+			n->gSteps = n->rhsSteps;
+
+			for( size_t i = 0; i < m_SuccessorNodes.size(); i ++ )
+			{
+				Node *successor = m_SuccessorNodes[i];
+				float rhs = n->g + m_SuccessorCosts[i];
+
+				if( successor != m_Start && CostLess( rhs, n->gSteps + 1, successor->rhs, successor->rhsSteps ) )
+				{
+					successor->rhs = rhs;
+					successor->rhsSteps = n->gSteps + 1;
+					successor->parent = n;
+					UpdateNode( successor );
+				}
+			}
+		}
+		else
+		{
+			// underconsistent, its cost has gone up so everything that was reached through it needs looking at again
+			n->g = FLT_MAX;
+			n->gSteps = 0;
+
+			if( n != m_Start && !ComputeRhs( n ) )
+			{
+				FreeAllNodes();
+				m_State = SEARCH_STATE_OUT_OF_MEMORY;
+				return m_State;
+			}
+
+			UpdateNode( n );
+
+			for( size_t i = 0; i < m_SuccessorNodes.size(); i ++ )
+			{
+				Node *successor = m_SuccessorNodes[i];
+
+				if( successor->parent == n && successor != m_Start )
+				{
+					if( !ComputeRhs( successor ) )
+					{
+						FreeAllNodes();
+						m_State = SEARCH_STATE_OUT_OF_MEMORY;
+						return m_State;
+					}
+
+					UpdateNode( successor );
+				}
+			}
+		}
+
+		return m_State;
+	}
+
+	// Runs the search until it ends or the budget runs out, see AStarSearch::Search
+	unsigned int Search( SearchResult &Result, unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64;
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( MaxSteps && stepsTaken >= MaxSteps )
+			{
+				break;
+			}
+
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		Result.state = m_State;
+		Result.steps = m_Steps;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.path.clear();
+
+		if( m_State == SEARCH_STATE_SUCCEEDED )
+		{
+			for( Node *node = m_Start; node; node = node->child )
+			{
+				Result.path.push_back( node->m_UserState );
+			}
+		}
+
+		return m_State;
+	}
+
+	SearchResult Search( unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, MaxSteps, Deadline );
+		return result;
+	}
+
+	// The cost of the edge From -> To has changed, GetCost must already return the new cost. The search is set
+	// searching again and the next Search or SearchStep repairs the solution. Returns false if the node pool ran out.
+	bool UpdateEdge( UserState &From, UserState &To )
+	{
+		if( m_State == SEARCH_STATE_NOT_INITIALISED || m_State == SEARCH_STATE_OUT_OF_MEMORY || !m_Start )
+		{
+			return true; // nothing planned, or cancelled
+		}
+
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			// a new repair, count its work from here
+			m_Steps = 0;
+			m_NodesExpanded = 0;
+			m_State = SEARCH_STATE_SEARCHING;
+		}
+
+		Node *from = m_Index.Find( From );
+		Node *to = m_Index.Find( To );
+
+		// an edge out of a node with no known cost, or into a node never generated, can't change anything yet
+		if( !from || !to || to == m_Start || from->g == FLT_MAX )
+		{
+			return true;
+		}
+
+		// rhs is worked out again over all the predecessors, the stored states may name a different edge between
+		// the two nodes when there are parallel edges, so the changed edge can't be priced through them
+		if( !ComputeRhs( to ) )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			return false;
+		}
+
+		UpdateNode( to );
+		return true;
+	}
+
+	// Abandons the search and frees all of its nodes
+	void CancelSearch()
+	{
+		if( m_State != SEARCH_STATE_NOT_INITIALISED )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// User calls this from GetSuccessors and GetPredecessors for each neighbouring state
+	bool AddSuccessor( UserState &State )
+	{
+		m_Successors.push_back( State );
+		return true;
+	}
+
+	// Free all the nodes, after this the search can no longer be repaired
+	void FreeSolutionNodes()
+	{
+		FreeAllNodes();
+	}
+
+	// Functions for traversing the solution, as for AStarSearch
+
+	UserState *GetSolutionStart()
+	{
+		m_CurrentSolutionNode = m_Start;
+		return m_Start ? &m_Start->m_UserState : NULL;
+	}
+
+	UserState *GetSolutionNext()
+	{
+		if( m_CurrentSolutionNode && m_CurrentSolutionNode->child )
+		{
+			m_CurrentSolutionNode = m_CurrentSolutionNode->child;
+			return &m_CurrentSolutionNode->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	UserState *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Goal;
+		return m_Goal ? &m_Goal->m_UserState : NULL;
+	}
+
+	UserState *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode && m_CurrentSolutionNode != m_Start && m_CurrentSolutionNode->parent )
+		{
+			m_CurrentSolutionNode = m_CurrentSolutionNode->parent;
+			return &m_CurrentSolutionNode->m_UserState;
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution, FLT_MAX if there is none
+	float GetSolutionCost()
+	{
+		return m_State == SEARCH_STATE_SUCCEEDED ? m_Goal->g : FLT_MAX;
+	}
+
+	int GetStepCount() { return m_Steps; }
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+	int GetAllocatedNodeCount() { return m_AllocateNodeCount; }
+
+private: // methods
+
+	// Finds the node for a state, creating it if the search has not seen the state before
+	Node *GetNode( UserState &State )
+	{
+		Node *node = m_Index.Find( State );
+
+		if( node )
+		{
+			return node;
+		}
+
+		node = m_NodePool.Allocate();
+
+		if( !node )
+		{
+			return NULL;
+		}
+
+		m_AllocateNodeCount ++;
+
+		node->m_UserState = State;
+		node->h = node->m_UserState.GoalDistanceEstimate( m_GoalState );
+
+		m_Index.Insert( node );
+		m_Nodes.push_back( node );
+
+		return node;
+	}
+
+	// Fills m_SuccessorNodes and m_SuccessorCosts with the successors of n, false if the node pool ran out
+	bool GetSuccessorNodes( Node *n )
+	{
+		m_Successors.clear();
+		m_SuccessorNodes.clear();
+		m_SuccessorCosts.clear();
+
+		if( !n->m_UserState.GetSuccessors( this, n->parent ? &n->parent->m_UserState : NULL ) )
+		{
+			return false;
+		}
+
+		for( size_t i = 0; i < m_Successors.size(); i ++ )
+		{
+			Node *successor = GetNode( m_Successors[i] );
+
+			if( !successor )
+			{
+				return false;
+			}
+
+			m_SuccessorNodes.push_back( successor );
+			m_SuccessorCosts.push_back( n->m_UserState.GetCost( m_Successors[i] ) );
+		}
+
+		return true;
+	}
+
+	// Works out rhs for a node from scratch over all of its predecessors, false if GetPredecessors failed
+	bool ComputeRhs( Node *node )
+	{
+		node->rhs = FLT_MAX;
+		node->rhsSteps = 0;
+		node->parent = NULL;
+
+		m_Successors.clear();
+
+		if( !node->m_UserState.GetPredecessors( this, NULL ) )
+		{
+			return false;
+		}
+
+		for( size_t i = 0; i < m_Successors.size(); i ++ )
+		{
+			// a predecessor the search has never reached has no cost to offer
+			Node *predecessor = m_Index.Find( m_Successors[i] );
+
+			if( !predecessor || predecessor->g == FLT_MAX )
+			{
+				continue;
+			}
+
+			// priced through the predecessor's state, which names the edge being scanned
+			float rhs = predecessor->g + m_Successors[i].GetCost( node->m_UserState );
+
+			if( CostLess( rhs, predecessor->gSteps + 1, node->rhs, node->rhsSteps ) )
+			{
+				node->rhs = rhs;
+				node->rhsSteps = predecessor->gSteps + 1;
+				node->parent = predecessor;
+			}
+		}
+
+		return true;
+	}
+
+	// Queues a node with its new key if it is inconsistent, takes it off the queue if it is not
+	void UpdateNode( Node *node )
+	{
+		if( !IsConsistent( node ) )
+		{
+			bool lower = CostLess( node->rhs, node->rhsSteps, node->g, node->gSteps );
+			float k2 = lower ? node->rhs : node->g;
+
+			node->k1 = k2 == FLT_MAX ? FLT_MAX : k2 + node->h;
+			node->k2 = k2;
+			node->kSteps = lower ? node->rhsSteps : node->gSteps;
+
+			if( node->m_Queued )
+			{
+				m_OpenList.Reposition( node );
+			}
+			else
+			{
+				node->m_Queued = true;
+				m_OpenList.Push( node );
+			}
+		}
+		else if( node->m_Queued )
+		{
+			node->m_Queued = false;
+			m_OpenList.Remove( node );
+		}
+	}
+
+	// Costs with the number of edges taken to reach them, compared on the cost and then the steps
+	static bool CostLess( float x, unsigned int xSteps, float y, unsigned int ySteps )
+	{
+		return x < y || ( x == y && xSteps < ySteps );
+	}
+
+	static bool KeyLess( float xk1, unsigned int xSteps, float xk2, float yk1, unsigned int ySteps, float yk2 )
+	{
+		return CostLess( xk1, xSteps, yk1, ySteps ) || ( xk1 == yk1 && xSteps == ySteps && xk2 < yk2 );
+	}
+
+	static bool IsConsistent( const Node *node )
+	{
+		return node->g == node->rhs && node->gSteps == node->rhsSteps;
+	}
+
+	// Compares the key a queued node has with the key a node would have now
+	bool QueuedBefore( Node *queued, Node *node )
+	{
+		bool lower = CostLess( node->rhs, node->rhsSteps, node->g, node->gSteps );
+		float k2 = lower ? node->rhs : node->g;
+		float k1 = k2 == FLT_MAX ? FLT_MAX : k2 + node->h;
+
+		return KeyLess( queued->k1, queued->kSteps, queued->k2, k1, lower ? node->rhsSteps : node->gSteps, k2 );
+	}
+
+	// Sets the child pointers along the parents from the goal back to the start. Each node is visited once, so parents
+	// that don't lead back to the start end the walk with false instead of going round for ever.
+	bool LinkSolution()
+	{
+		if( ++ m_Stamp == 0 )
+		{
+			for( size_t i = 0; i < m_Nodes.size(); i ++ )
+			{
+				m_Nodes[i]->m_Stamp = 0;
+			}
+
+			m_Stamp = 1;
+		}
+
+		m_Goal->child = NULL;
+
+		for( Node *node = m_Goal; node != m_Start; node = node->parent )
+		{
+			if( !node->parent || node->m_Stamp == m_Stamp )
+			{
+				return false;
+			}
+
+			node->m_Stamp = m_Stamp;
+			node->parent->child = node;
+		}
+
+		return true;
+	}
+
+	void FreeAllNodes()
+	{
+		for( size_t i = 0; i < m_Nodes.size(); i ++ )
+		{
+			m_NodePool.Free( m_Nodes[i] );
+		}
+
+		m_AllocateNodeCount -= (int)m_Nodes.size();
+
+		m_Nodes.clear();
+		m_Index.Clear();
+		m_OpenList.Clear();
+
+		m_Start = m_Goal = NULL;
+		m_CurrentSolutionNode = NULL;
+	}
+
+private: // data
+
+	OpenList< Node, HeapCompare_k > m_OpenList;
+
+	// Every node the search has created, and the index to find them by state
+	vector< Node * > m_Nodes;
+	AStarHashIndex< Node > m_Index;
+
+	// Filled out by the user each time the neighbours of a node are generated
+	vector< UserState > m_Successors;
+
+	// The successors of the node being expanded and the cost of reaching each of them
+	vector< Node * > m_SuccessorNodes;
+	vector< float > m_SuccessorCosts;
+
+	unsigned int m_State;
+	int m_Steps;
+	unsigned int m_NodesExpanded;
+
+	UserState m_GoalState;
+	Node *m_Start;
+	Node *m_Goal;
+
+	Node *m_CurrentSolutionNode;
+
+	// LinkSolution marks the nodes it has passed with this
+	unsigned int m_Stamp;
+
+	AStarNodePool< Node > m_NodePool;
+	int m_AllocateNodeCount;
+};
+
+// Incremental A* Ends --------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Jump Point Search Code Starts ----------------------------------------------------------------------------------------------------------------
+
+// Uniform cost grids. Moves go to any of the 8 neighbouring cells, a straight move costs 1 and a diagonal one the
+// square root of 2, and a diagonal move may not cut the corner of a blocked cell, both cells beside it must be open.
+
+static const float GRID_DIAGONAL_COST = 1.41421356f;
+
+// Cost of the cheapest way dx columns and dy rows across an open grid, the heuristic for both grid searches
+inline float GridOctileDistance( int dx, int dy )
+{
+	dx = abs( dx );
+	dy = abs( dy );
+
+	return dx > dy ? ( dx - dy ) + dy * GRID_DIAGONAL_COST : ( dy - dx ) + dx * GRID_DIAGONAL_COST;
+}
+
+// Occupancy grid with one bit per cell. The bits are kept twice, by rows and by columns, so a scan along either reads
+// 64 cells at a time. Every line has a blocked cell before its first and after its last, and there is a blocked line
+// before the first and after the last, so scans never have to check the bounds.
+
+class GridMap
+{
+public:
+
+	GridMap() :
+		m_Width( 0 ),
+		m_Height( 0 )
+	{
+	}
+
+	// Makes a Width by Height grid with every cell open
+	void Resize( unsigned int Width, unsigned int Height )
+	{
+		m_Width = Width;
+		m_Height = Height;
+		m_Rows.Resize( Height, Width );
+		m_Columns.Resize( Width, Height );
+
+		for( unsigned int y = 0; y < Height; y ++ )
+		{
+			for( unsigned int x = 0; x < Width; x ++ )
+			{
+				SetBlocked( x, y, false );
+			}
+		}
+	}
+
+	// Reads a map in the Moving AI benchmark format, a header of "type", "height" and "width" lines ended by "map" and
+	// then one line of cells per row, where '.', 'G' and 'S' are open and anything else is blocked
+	bool Load( const char *Path )
+	{
+		ifstream in( Path );
+		string word;
+		unsigned int width = 0, height = 0;
+
+		while( in >> word && word != "map" )
+		{
+			if( word == "height" )
+			{
+				in >> height;
+			}
+			else if( word == "width" )
+			{
+				in >> width;
+			}
+		}
+
+		if( !in || !width || !height )
+		{
+			return false;
+		}
+
+		Resize( width, height );
+
+		string line;
+		getline( in, line ); // the rest of the "map" line
+
+		for( unsigned int y = 0; y < height; y ++ )
+		{
+			if( !getline( in, line ) || line.size() < width )
+			{
+				return false;
+			}
+
+			for( unsigned int x = 0; x < width; x ++ )
+			{
+				SetBlocked( x, y, !( line[x] == '.' || line[x] == 'G' || line[x] == 'S' ) );
+			}
+		}
+
+		return true;
+	}
+
+	void SetBlocked( unsigned int x, unsigned int y, bool Blocked )
+	{
+		m_Rows.Set( y, x, !Blocked );
+		m_Columns.Set( x, y, !Blocked );
+	}
+
+	// Cells off the grid count as blocked
+	bool IsOpen( int x, int y ) const
+	{
+		return (unsigned int)x < m_Width && (unsigned int)y < m_Height && m_Rows.Get( y, x );
+	}
+
+	// Scans row Line (or column Line, when Vertical) from the cell at Pos in direction Dir, +1 or -1, for the first cell
+	// that is blocked or has a forced neighbour: a cell open on the next line over whose cell behind it is blocked, so
+	// it can't be reached as cheaply without passing through the scanned cell. Returns the cell's position, -1 or the
+	// line's length when the scan runs off the grid.
+	int Scan( bool Vertical, int Line, int Pos, int Dir ) const
+	{
+		return Vertical ? m_Columns.Scan( Line, Pos, Dir ) : m_Rows.Scan( Line, Pos, Dir );
+	}
+
+	unsigned int GetWidth() const { return m_Width; }
+	unsigned int GetHeight() const { return m_Height; }
+
+	size_t MemoryUsage() const
+	{
+		return m_Rows.MemoryUsage() + m_Columns.MemoryUsage();
+	}
+
+private:
+
+	class Lines // Bits for Count lines of Length cells, bit p + 1 of a line is the cell at p
+	{
+		public:
+
+			Lines() :
+				m_Words( 0 )
+			{
+			}
+
+			void Resize( unsigned int Count, unsigned int Length )
+			{
+				m_Words = ( Length + 2 + 63 ) / 64;
+				m_Bits.assign( (size_t)( Count + 2 ) * m_Words, 0 );
+			}
+
+			bool Get( int Line, int Pos ) const
+			{
+				size_t bit = Pos + 1;
+				return ( m_Bits[ (size_t)( Line + 1 ) * m_Words + bit / 64 ] >> ( bit % 64 ) ) & 1;
+			}
+
+			void Set( int Line, int Pos, bool Open )
+			{
+				size_t bit = Pos + 1;
+				uint64_t &word = m_Bits[ (size_t)( Line + 1 ) * m_Words + bit / 64 ];
+
+				word = Open ? word | ( 1ULL << ( bit % 64 ) ) : word & ~( 1ULL << ( bit % 64 ) );
+			}
+
+			int Scan( int Line, int Pos, int Dir ) const
+			{
+				const uint64_t *before = &m_Bits[ (size_t)Line * m_Words ]; // the line before, Line + 1 is this line
+				const uint64_t *line = before + m_Words;
+				const uint64_t *after = line + m_Words;
+				size_t bit = Pos + 1;
+
+				if( Dir > 0 )
+				{
+					bit ++;
+					uint64_t mask = ~0ULL << ( bit % 64 );
+
+					for( size_t w = bit / 64; ; w ++, mask = ~0ULL )
+					{
+						// bit i of behind is the cell at i - 1, the one behind i in the direction of the scan
+						uint64_t behindBefore = ( before[w] << 1 ) | ( w ? before[w - 1] >> 63 : 0 );
+						uint64_t behindAfter = ( after[w] << 1 ) | ( w ? after[w - 1] >> 63 : 0 );
+						uint64_t stop = ( ~line[w] | ( before[w] & ~behindBefore ) | ( after[w] & ~behindAfter ) ) & mask;
+
+						if( stop )
+						{
+							return (int)( w * 64 + __builtin_ctzll( stop ) ) - 1;
+						}
+					}
+				}
+
+				bit --;
+				uint64_t mask = bit % 64 == 63 ? ~0ULL : ( 1ULL << ( bit % 64 + 1 ) ) - 1;
+
+				for( size_t w = bit / 64; ; w --, mask = ~0ULL )
+				{
+					// scanning backwards the cell behind i is at i + 1
+					uint64_t behindBefore = ( before[w] >> 1 ) | ( w + 1 < m_Words ? before[w + 1] << 63 : 0 );
+					uint64_t behindAfter = ( after[w] >> 1 ) | ( w + 1 < m_Words ? after[w + 1] << 63 : 0 );
+					uint64_t stop = ( ~line[w] | ( before[w] & ~behindBefore ) | ( after[w] & ~behindAfter ) ) & mask;
+
+					if( stop )
+					{
+						return (int)( w * 64 + 63 - __builtin_clzll( stop ) ) - 1;
+					}
+				}
+			}
+
+			size_t MemoryUsage() const
+			{
+				return m_Bits.capacity() * sizeof( uint64_t );
+			}
+
+		private:
+
+			size_t m_Words; // per line
+			vector< uint64_t > m_Bits;
+	};
+
+	unsigned int m_Width;
+	unsigned int m_Height;
+	Lines m_Rows;
+	Lines m_Columns;
+};
+
+class GridCell // A cell of a GridMap, the state AStarJPSSearch's solutions are made of
+{
+public:
+
+	int x;
+	int y;
+
+	GridCell() : x( 0 ), y( 0 ) {}
+	GridCell( int X, int Y ) : x( X ), y( Y ) {}
+
+	bool IsSameState( GridCell &rhs )
+	{
+		return x == rhs.x && y == rhs.y;
+	}
+
+	void PrintNodeInfo()
+	{
+		cout << "(" << x << "," << y << ")";
+	}
+};
+
+// A grid cell as a UserState for the general searches, which look at every neighbour of every cell they expand. For
+// uniform costs AStarJPSSearch finds the same cost paths expanding far fewer cells, this is what it is measured against.
+
+class GridMapNode
+{
+public:
+
+	const GridMap *m_Map;
+	int x;
+	int y;
+
+	GridMapNode() : m_Map( NULL ), x( 0 ), y( 0 ) {}
+	GridMapNode( const GridMap *Map, int X, int Y ) : m_Map( Map ), x( X ), y( Y ) {}
+
+	float GoalDistanceEstimate( GridMapNode &nodeGoal )
+	{
+		return GridOctileDistance( nodeGoal.x - x, nodeGoal.y - y );
+	}
+
+	bool IsGoal( GridMapNode &nodeGoal )
+	{
+		return x == nodeGoal.x && y == nodeGoal.y;
+	}
+
+	template <class AStarSearchType> bool GetSuccessors( AStarSearchType *astarsearch, GridMapNode *parent_node )
+	{
+		for( int dy = -1; dy <= 1; dy ++ )
+		{
+			for( int dx = -1; dx <= 1; dx ++ )
+			{
+				if( ( !dx && !dy ) || !m_Map->IsOpen( x + dx, y + dy ) )
+				{
+					continue;
+				}
+
+				if( dx && dy && ( !m_Map->IsOpen( x + dx, y ) || !m_Map->IsOpen( x, y + dy ) ) )
+				{
+					continue; // would cut a corner
+				}
+
+				GridMapNode NewNode( m_Map, x + dx, y + dy );
+
+				if( !astarsearch->AddSuccessor( NewNode ) )
+				{
+					return false; // out of node memory
+				}
+			}
+		}
+
+		return true;
+	}
+
+	float GetCost( GridMapNode &successor )
+	{
+		return x != successor.x && y != successor.y ? GRID_DIAGONAL_COST : 1.0f;
+	}
+
+	bool IsSameState( GridMapNode &rhs )
+	{
+		return x == rhs.x && y == rhs.y;
+	}
+
+	size_t Hash()
+	{
+		return (size_t)y * m_Map->GetWidth() + x;
+	}
+
+	unsigned int Id()
+	{
+		return (unsigned int)y * m_Map->GetWidth() + x;
+	}
+
+	void PrintNodeInfo()
+	{
+		cout << "(" << x << "," << y << ")";
+	}
+};
+
+// A* on a GridMap with Jump Point Search (Harabor and Grastien) successor pruning. Of all the equally short paths
+// across open ground only one is worth looking at, so from each expanded cell the search carries straight on (or
+// diagonally, checking the straight lines off the diagonal as it goes) until it reaches the goal, a wall, or a cell
+// with a forced neighbour that only a path turning there reaches as cheaply. Only those jump points go on the open
+// list. On open maps that is a small fraction of the cells plain A* expands, and the straight scans run 64 cells to a
+// word through GridMap::Scan. The paths cost the same as with GridMapNode and AStarSearch.
+//
+// It is used the same way as AStarSearch, with GridCell for the states. The solution is given cell by cell, the
+// straight runs between jump points filled in. Nodes are kept in an array of one per cell of the map, reused from
+// search to search, so the map must not be resized while a search uses it.
+
+template <template <class, class> class OpenList = AStarBinaryHeap> class AStarJPSSearch
+{
+
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	enum { NO_CELL = 0xffffffff };
+
+	class Node // The search's data for one cell, only valid while m_Stamp is the search's generation
+	{
+		public:
+			float g;
+			float f;
+			unsigned int parent; // the cell of the jump point this one was reached from, NO_CELL for the start
+			unsigned int m_ListIndex; // position in the open heap, NO_CELL once closed
+			unsigned int m_Stamp;
+			Node() :
+				g( 0.0f ),
+				f( 0.0f ),
+				parent( NO_CELL ),
+				m_ListIndex( NO_CELL ),
+				m_Stamp( 0 )
+			{}
+	};
+
+	class HeapCompare_f // Orders by f, and of equal f the node furthest along, which saves expanding ties on open ground
+	{
+		public:
+
+			bool operator() ( const Node *x, const Node *y ) const
+			{
+				return x->f > y->f || ( x->f == y->f && x->g < y->g );
+			}
+	};
+
+	class SearchResult // Outcome of a one-shot Search()
+	{
+		public:
+
+			unsigned int state;
+			vector< GridCell > path;
+			float cost;
+			unsigned int steps;
+			unsigned int nodesExpanded;
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( FLT_MAX ),
+				steps( 0 ),
+				nodesExpanded( 0 )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef GridCell UserStateType;
+
+
+public: // methods
+
+
+	AStarJPSSearch( const GridMap &Map ) :
+		m_Map( Map ),
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Steps( 0 ),
+		m_NodesExpanded( 0 ),
+		m_Generation( 1 ),
+		m_SolutionCost( FLT_MAX ),
+		m_CurrentSolutionNode( 0 )
+	{
+	}
+
+	// Set Start and goal states, a search from or to a blocked cell fails straight away
+	void SetStartAndGoalStates( GridCell &Start, GridCell &Goal )
+	{
+		FreeAllNodes();
+
+		m_Steps = 0;
+		m_NodesExpanded = 0;
+		m_Goal = Goal;
+
+		if( !m_Map.IsOpen( Start.x, Start.y ) || !m_Map.IsOpen( Goal.x, Goal.y ) )
+		{
+			m_State = SEARCH_STATE_FAILED;
+			return;
+		}
+
+		size_t cells = (size_t)m_Map.GetWidth() * m_Map.GetHeight();
+
+		if( m_Nodes.size() != cells )
+		{
+			m_Nodes.assign( cells, Node() );
+		}
+
+		m_State = SEARCH_STATE_SEARCHING;
+
+		Reach( Start.x, Start.y, NO_CELL, 0.0f );
+	}
+
+	// Advances search one step
+	unsigned int SearchStep()
+	{
+		if( m_State != SEARCH_STATE_SEARCHING )
+		{
+			return m_State;
+		}
+
+		// Failure is defined as emptying the open list as there is nothing left to search
+		if( m_OpenList.Empty() )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+			return m_State;
+		}
+
+		m_Steps ++;
+
+		Node *n = m_OpenList.Pop();
+		n->m_ListIndex = NO_CELL;
+
+		unsigned int cell = (unsigned int)( n - &m_Nodes[0] );
+		int x = cell % m_Map.GetWidth();
+		int y = cell / m_Map.GetWidth();
+
+		if( x == m_Goal.x && y == m_Goal.y )
+		{
+			LinkSolution( cell );
+			m_SolutionCost = n->g;
+			m_State = SEARCH_STATE_SUCCEEDED;
+			return m_State;
+		}
+
+		m_NodesExpanded ++;
+
+		// The directions worth jumping in, all 8 from the start. Otherwise carry on the way the node was reached and,
+		// after a straight move, turn towards any forced neighbour.
+		int directions[8][2];
+		int count = 0;
+
+		if( n->parent == NO_CELL )
+		{
+			for( int dy = -1; dy <= 1; dy ++ )
+			{
+				for( int dx = -1; dx <= 1; dx ++ )
+				{
+					if( dx || dy )
+					{
+						directions[count][0] = dx;
+						directions[count][1] = dy;
+						count ++;
+					}
+				}
+			}
+		}
+		else
+		{
+			int dx = Sign( x - (int)( n->parent % m_Map.GetWidth() ) );
+			int dy = Sign( y - (int)( n->parent / m_Map.GetWidth() ) );
+
+			directions[count][0] = dx;
+			directions[count][1] = dy;
+			count ++;
+
+			if( dx && dy )
+			{
+				directions[count][0] = dx;
+				directions[count][1] = 0;
+				count ++;
+				directions[count][0] = 0;
+				directions[count][1] = dy;
+				count ++;
+			}
+			else
+			{
+				for( int side = -1; side <= 1; side += 2 )
+				{
+					// the cell to the side, taken along the line across the direction of travel
+					int sx = dx ? 0 : side;
+					int sy = dx ? side : 0;
+
+					if( m_Map.IsOpen( x + sx, y + sy ) && !m_Map.IsOpen( x + sx - dx, y + sy - dy ) )
+					{
+						directions[count][0] = sx;
+						directions[count][1] = sy;
+						count ++;
+						directions[count][0] = dx + sx;
+						directions[count][1] = dy + sy;
+						count ++;
+					}
+				}
+			}
+		}
+
+		for( int i = 0; i < count; i ++ )
+		{
+			int jx, jy;
+
+			if( Jump( x, y, directions[i][0], directions[i][1], jx, jy ) )
+			{
+				Reach( jx, jy, cell, n->g + GridOctileDistance( jx - x, jy - y ) );
+			}
+		}
+
+		return m_State;
+	}
+
+	// Runs the search until it ends or the budget runs out, see AStarSearch::Search
+	unsigned int Search( SearchResult &Result, unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		const unsigned int StepsPerClockCheck = 64;
+
+		bool timed = Deadline != Clock::time_point::max();
+		unsigned int stepsTaken = 0;
+
+		while( m_State == SEARCH_STATE_SEARCHING )
+		{
+			if( MaxSteps && stepsTaken >= MaxSteps )
+			{
+				break;
+			}
+
+			if( timed && (stepsTaken % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+			{
+				break;
+			}
+
+			SearchStep();
+			stepsTaken ++;
+		}
+
+		Result.state = m_State;
+		Result.steps = m_Steps;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.path = m_Solution;
+
+		return m_State;
+	}
+
+	SearchResult Search( unsigned int MaxSteps = 0, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, MaxSteps, Deadline );
+		return result;
+	}
+
+	// Abandons a search that is still running
+	void CancelSearch()
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// Lets go of the solution once it has been used. The node array is kept for the next search.
+	void FreeSolutionNodes()
+	{
+		FreeAllNodes();
+	}
+
+	// Functions for traversing the solution, as for AStarSearch
+
+	GridCell *GetSolutionStart()
+	{
+		m_CurrentSolutionNode = 0;
+		return m_Solution.empty() ? NULL : &m_Solution[0];
+	}
+
+	GridCell *GetSolutionNext()
+	{
+		if( m_CurrentSolutionNode + 1 < m_Solution.size() )
+		{
+			m_CurrentSolutionNode ++;
+			return &m_Solution[ m_CurrentSolutionNode ];
+		}
+
+		return NULL;
+	}
+
+	GridCell *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Solution.empty() ? 0 : m_Solution.size() - 1;
+		return m_Solution.empty() ? NULL : &m_Solution.back();
+	}
+
+	GridCell *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode > 0 && m_CurrentSolutionNode < m_Solution.size() )
+		{
+			m_CurrentSolutionNode --;
+			return &m_Solution[ m_CurrentSolutionNode ];
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution, FLT_MAX if there is none
+	float GetSolutionCost()
+	{
+		return m_State == SEARCH_STATE_SUCCEEDED ? m_SolutionCost : FLT_MAX;
+	}
+
+	int GetStepCount() { return m_Steps; }
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+
+	// Bytes held by the node array, the open heap and the solution, not counting the map
+	size_t GetMemoryUsage()
+	{
+		return m_Nodes.capacity() * sizeof( Node ) + m_OpenList.MemoryUsage() + m_Solution.capacity() * sizeof( GridCell );
+	}
+
+private: // methods
+
+	static int Sign( int v )
+	{
+		return ( v > 0 ) - ( v < 0 );
+	}
+
+	// A path to cell (x, y) costing g through the jump point at Parent, opens the cell if that is the cheapest so far
+	void Reach( int x, int y, unsigned int Parent, float g )
+	{
+		Node &node = m_Nodes[ (size_t)y * m_Map.GetWidth() + x ];
+		bool reached = node.m_Stamp == m_Generation;
+
+		if( reached && node.g <= g )
+		{
+			return;
+		}
+
+		node.m_Stamp = m_Generation;
+		node.g = g;
+		node.f = g + GridOctileDistance( m_Goal.x - x, m_Goal.y - y );
+		node.parent = Parent;
+
+		if( reached && node.m_ListIndex != NO_CELL )
+		{
+			m_OpenList.Update( &node );
+		}
+		else
+		{
+			m_OpenList.Push( &node ); // new, or closed and reached more cheaply
+		}
+	}
+
+	// Carries on from (x, y) in direction (dx, dy) to the next jump point, false if there is none that way
+	bool Jump( int x, int y, int dx, int dy, int &jx, int &jy )
+	{
+		if( !dx || !dy )
+		{
+			return JumpStraight( x, y, dx, dy, jx, jy );
+		}
+
+		for( ;; )
+		{
+			if( !m_Map.IsOpen( x + dx, y ) || !m_Map.IsOpen( x, y + dy ) || !m_Map.IsOpen( x + dx, y + dy ) )
+			{
+				return false;
+			}
+
+			x += dx;
+			y += dy;
+
+			// a diagonal cell is a jump point when either straight line off it leads to one
+			int sx, sy;
+
+			if( ( x == m_Goal.x && y == m_Goal.y ) || JumpStraight( x, y, dx, 0, sx, sy ) || JumpStraight( x, y, 0, dy, sx, sy ) )
+			{
+				jx = x;
+				jy = y;
+				return true;
+			}
+		}
+	}
+
+	bool JumpStraight( int x, int y, int dx, int dy, int &jx, int &jy )
+	{
+		bool vertical = dx == 0;
+		int line = vertical ? x : y;
+		int pos = vertical ? y : x;
+		int dir = vertical ? dy : dx;
+		int goalPos = vertical ? m_Goal.y : m_Goal.x;
+		int stop = m_Map.Scan( vertical, line, pos, dir );
+
+		if( ( vertical ? m_Goal.x : m_Goal.y ) == line && ( goalPos - pos ) * dir > 0 && ( stop - goalPos ) * dir >= 0 )
+		{
+			stop = goalPos; // the goal comes first
+		}
+		else if( !( vertical ? m_Map.IsOpen( line, stop ) : m_Map.IsOpen( stop, line ) ) )
+		{
+			return false; // ran into a wall
+		}
+
+		jx = vertical ? line : stop;
+		jy = vertical ? stop : line;
+		return true;
+	}
+
+	// Walks the jump points back from the goal, then fills in the cells between them from the start
+	void LinkSolution( unsigned int Goal )
+	{
+		vector< unsigned int > jumpPoints;
+
+		for( unsigned int cell = Goal; cell != NO_CELL; cell = m_Nodes[cell].parent )
+		{
+			jumpPoints.push_back( cell );
+		}
+
+		unsigned int width = m_Map.GetWidth();
+		GridCell at( jumpPoints.back() % width, jumpPoints.back() / width );
+
+		m_Solution.push_back( at );
+
+		for( size_t i = jumpPoints.size() - 1; i -- > 0; )
+		{
+			GridCell to( jumpPoints[i] % width, jumpPoints[i] / width );
+			int dx = Sign( to.x - at.x );
+			int dy = Sign( to.y - at.y );
+
+			while( !at.IsSameState( to ) )
+			{
+				at.x += dx;
+				at.y += dy;
+				m_Solution.push_back( at );
+			}
+		}
+	}
+
+	void FreeAllNodes()
+	{
+		m_OpenList.Clear();
+		m_Solution.clear();
+		m_CurrentSolutionNode = 0;
+		m_Generation ++;
+
+		if( m_Generation == 0 )
+		{
+			// the stamps have wrapped round, this happens once every 2^32 searches
+			for( size_t i = 0; i < m_Nodes.size(); i ++ )
+			{
+				m_Nodes[i].m_Stamp = 0;
+			}
+
+			m_Generation = 1;
+		}
+	}
+
+private: // data
+
+	const GridMap &m_Map;
+
+	// One node per cell of the map, indexed by y * width + x
+	vector< Node > m_Nodes;
+
+	OpenList< Node, HeapCompare_f > m_OpenList;
+
+	unsigned int m_State;
+	int m_Steps;
+	unsigned int m_NodesExpanded;
+	unsigned int m_Generation; // nodes stamped with anything else haven't been reached by this search
+
+	GridCell m_Goal;
+
+	// The solution's cells from start to goal
+	vector< GridCell > m_Solution;
+	float m_SolutionCost;
+	size_t m_CurrentSolutionNode;
+};
+
+// Jump Point Search Ends -----------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// CSR Graph Code Starts ------------------------------------------------------------------------------------------------------------------------
+
+class LandmarkTable;
+
+// Straight line distances from the nodes Nodes[0 .. Count) to the point (ToX, ToY), with the coordinates of node n at
+// X[n], Y[n]. With AVX2 eight nodes are done at a time, their coordinates fetched with gather loads, and a short
+// tail (a road node has only a few successors) is done with masked loads and stores rather than a scalar loop.
+inline void CSREuclideanDistances( const float *X, const float *Y, const unsigned int *Nodes, unsigned int Count, float ToX, float ToY, float *Distances )
+{
+	unsigned int i = 0;
+
+#ifdef __AVX2__
+	const __m256 toX = _mm256_set1_ps( ToX );
+	const __m256 toY = _mm256_set1_ps( ToY );
+
+	for( ; i < Count; i += 8 )
+	{
+		int remaining = (int)( Count - i );
+		__m256i mask = _mm256_cmpgt_epi32( _mm256_set1_epi32( remaining ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+		__m256i nodes = _mm256_maskload_epi32( (const int *)( Nodes + i ), mask );
+
+		__m256 dx = _mm256_sub_ps( _mm256_mask_i32gather_ps( _mm256_setzero_ps(), X, nodes, _mm256_castsi256_ps( mask ), 4 ), toX );
+		__m256 dy = _mm256_sub_ps( _mm256_mask_i32gather_ps( _mm256_setzero_ps(), Y, nodes, _mm256_castsi256_ps( mask ), 4 ), toY );
+		__m256 distance = _mm256_sqrt_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ) );
+
+		_mm256_maskstore_ps( Distances + i, mask, distance );
+	}
+#else
+	for( ; i < Count; i ++ )
+	{
+		float dx = X[ Nodes[i] ] - ToX;
+		float dy = Y[ Nodes[i] ] - ToY;
+
+		Distances[i] = sqrtf( dx * dx + dy * dy );
+	}
+#endif
+}
+
+// A directed weighted graph in compressed sparse row form. The out edges of node n are the edge indices
+// [ EdgesBegin(n), EdgesEnd(n) ), sorted by target, with the targets and weights held in two contiguous arrays.
+// Memory is O(V + E) and enumerating the neighbours of a node only touches its own edges.
+
+class CSREdge // One edge of the edge list a CSRGraph is built from
+{
+public:
+
+	unsigned int from;
+	unsigned int to;
+	float weight;
+};
+
+class CSRGraph
+{
+public:
+
+	CSRGraph() :
+		m_NodeCount( 0 ),
+		m_EdgeCount( 0 ),
+		m_Offsets( NULL ),
+		m_Targets( NULL ),
+		m_Weights( NULL ),
+		m_X( NULL ),
+		m_Y( NULL ),
+		m_NameOffsets( NULL ),
+		m_NameChars( NULL ),
+		m_Landmarks( NULL )
+	{
+	}
+
+	// Builds the graph from an edge list in O(V + E), apart from sorting each node's edges by target
+	void Build( unsigned int NodeCount, const vector< CSREdge > &Edges )
+	{
+		m_OffsetStorage.assign( NodeCount + 1, 0 );
+		m_TargetStorage.resize( Edges.size() );
+		m_WeightStorage.resize( Edges.size() );
+
+		// count the out degree of each node, then turn the counts into row offsets
+		for( size_t i = 0; i < Edges.size(); i ++ )
+		{
+			m_OffsetStorage[ Edges[i].from + 1 ] ++;
+		}
+
+		for( unsigned int n = 0; n < NodeCount; n ++ )
+		{
+			m_OffsetStorage[n + 1] += m_OffsetStorage[n];
+		}
+
+		vector< unsigned int > next( m_OffsetStorage.begin(), m_OffsetStorage.end() - 1 );
+		vector< pair< unsigned int, float > > row;
+
+		for( size_t i = 0; i < Edges.size(); i ++ )
+		{
+			unsigned int e = next[ Edges[i].from ] ++;
+
+			m_TargetStorage[e] = Edges[i].to;
+			m_WeightStorage[e] = Edges[i].weight;
+		}
+
+		for( unsigned int n = 0; n < NodeCount; n ++ )
+		{
+			unsigned int begin = m_OffsetStorage[n], end = m_OffsetStorage[n + 1];
+
+			row.clear();
+
+			for( unsigned int e = begin; e < end; e ++ )
+			{
+				row.push_back( make_pair( m_TargetStorage[e], m_WeightStorage[e] ) );
+			}
+
+			sort( row.begin(), row.end() );
+
+			for( unsigned int e = begin; e < end; e ++ )
+			{
+				m_TargetStorage[e] = row[e - begin].first;
+				m_WeightStorage[e] = row[e - begin].second;
+			}
+		}
+
+		m_XStorage.clear();
+		m_YStorage.clear();
+		m_NameOffsetStorage.clear();
+		m_NameCharStorage.clear();
+		m_ReverseOffsets.clear();
+
+		m_NodeCount = NodeCount;
+		m_EdgeCount = (unsigned int)Edges.size();
+		m_Offsets = &m_OffsetStorage[0];
+		m_Targets = m_TargetStorage.empty() ? NULL : &m_TargetStorage[0];
+		m_Weights = m_WeightStorage.empty() ? NULL : &m_WeightStorage[0];
+		m_X = m_Y = NULL;
+		m_NameOffsets = NULL;
+		m_NameChars = NULL;
+		m_Landmarks = NULL;
+	}
+
+	// Points the graph at arrays owned by someone else, such as a mapped graph file. Nothing is copied, the arrays
+	// must outlive the graph. X, Y and the two name arrays may be NULL.
+	void Attach( unsigned int NodeCount, unsigned int EdgeCount, const unsigned int *Offsets, const unsigned int *Targets, const float *Weights,
+		const float *X, const float *Y, const unsigned int *NameOffsets, const char *NameChars )
+	{
+		m_OffsetStorage.clear();
+		m_TargetStorage.clear();
+		m_WeightStorage.clear();
+		m_XStorage.clear();
+		m_YStorage.clear();
+		m_NameOffsetStorage.clear();
+		m_NameCharStorage.clear();
+		m_ReverseOffsets.clear();
+
+		m_NodeCount = NodeCount;
+		m_EdgeCount = EdgeCount;
+		m_Offsets = Offsets;
+		m_Targets = Targets;
+		m_Weights = Weights;
+		m_X = X;
+		m_Y = Y;
+		m_NameOffsets = NameChars ? NameOffsets : NULL;
+		m_NameChars = NameOffsets ? NameChars : NULL;
+		m_Landmarks = NULL;
+	}
+
+	// Optional node coordinates, used for a straight line distance heuristic. They must be in the same units as the
+	// edge weights and no edge may be shorter than the straight line between its ends, or the estimate is not admissible.
+	void SetCoordinates( const vector< float > &X, const vector< float > &Y )
+	{
+		m_XStorage = X;
+		m_YStorage = Y;
+		m_X = &m_XStorage[0];
+		m_Y = &m_YStorage[0];
+	}
+
+	unsigned int GetNodeCount() const { return m_NodeCount; }
+	unsigned int GetEdgeCount() const { return m_EdgeCount; }
+
+	unsigned int EdgesBegin( unsigned int Node ) const { return m_Offsets[Node]; }
+	unsigned int EdgesEnd( unsigned int Node ) const { return m_Offsets[Node + 1]; }
+	unsigned int GetEdgeTarget( unsigned int Edge ) const { return m_Targets[Edge]; }
+	float GetEdgeWeight( unsigned int Edge ) const { return m_Weights[Edge]; }
+
+	// Changes the weight of an edge. A graph attached to outside memory, such as a mapped graph file, first takes its
+	// own copy of the weights so the memory it was attached to is never written. Landmark tables and coordinates
+	// only stay admissible as long as no weight drops below what they were built for.
+	void SetEdgeWeight( unsigned int Edge, float Weight )
+	{
+		if( m_WeightStorage.empty() )
+		{
+			m_WeightStorage.assign( m_Weights, m_Weights + m_EdgeCount );
+			m_Weights = &m_WeightStorage[0];
+		}
+
+		m_WeightStorage[Edge] = Weight;
+	}
+
+	// Finds the cheapest edge From -> To by binary search of From's edges, returns the number of edges if there is none
+	unsigned int FindEdge( unsigned int From, unsigned int To ) const
+	{
+		const unsigned int *first = m_Targets + m_Offsets[From];
+		const unsigned int *last = m_Targets + m_Offsets[From + 1];
+		const unsigned int *edge = lower_bound( first, last, To );
+
+		if( edge == last || *edge != To )
+		{
+			return m_EdgeCount;
+		}
+
+		unsigned int best = (unsigned int)(edge - m_Targets);
+
+		// parallel edges sit next to each other, take the cheapest
+		for( unsigned int e = best + 1; e < m_Offsets[From + 1] && m_Targets[e] == To; e ++ )
+		{
+			if( m_Weights[e] < m_Weights[best] )
+			{
+				best = e;
+			}
+		}
+
+		return best;
+	}
+
+	// Returns the weight of the edge From -> To, or FLT_MAX if there is no such edge
+	float GetEdgeWeight( unsigned int From, unsigned int To ) const
+	{
+		unsigned int edge = FindEdge( From, To );
+
+		return edge == m_EdgeCount ? FLT_MAX : m_Weights[edge];
+	}
+
+	// Reverse adjacency, for searches that walk edges backwards. The in edges of node n are [ InEdgesBegin(n),
+	// InEdgesEnd(n) ), each one naming the forward edge it mirrors so the weights are shared with the forward arrays.
+	void BuildReverse()
+	{
+		m_ReverseOffsets.assign( m_NodeCount + 1, 0 );
+		m_ReverseEdges.resize( m_EdgeCount );
+		m_ReverseSources.resize( m_EdgeCount );
+
+		for( unsigned int e = 0; e < m_EdgeCount; e ++ )
+		{
+			m_ReverseOffsets[ m_Targets[e] + 1 ] ++;
+		}
+
+		for( unsigned int n = 0; n < m_NodeCount; n ++ )
+		{
+			m_ReverseOffsets[n + 1] += m_ReverseOffsets[n];
+		}
+
+		vector< unsigned int > next( m_ReverseOffsets.begin(), m_ReverseOffsets.end() - 1 );
+
+		for( unsigned int n = 0; n < m_NodeCount; n ++ )
+		{
+			for( unsigned int e = m_Offsets[n]; e < m_Offsets[n + 1]; e ++ )
+			{
+				unsigned int r = next[ m_Targets[e] ] ++;
+
+				m_ReverseEdges[r] = e;
+				m_ReverseSources[r] = n;
+			}
+		}
+	}
+
+	bool HasReverse() const { return !m_ReverseOffsets.empty(); }
+	unsigned int InEdgesBegin( unsigned int Node ) const { return m_ReverseOffsets[Node]; }
+	unsigned int InEdgesEnd( unsigned int Node ) const { return m_ReverseOffsets[Node + 1]; }
+	unsigned int GetInEdgeSource( unsigned int InEdge ) const { return m_ReverseSources[InEdge]; }
+	unsigned int GetInEdgeForward( unsigned int InEdge ) const { return m_ReverseEdges[InEdge]; }
+
+	bool HasCoordinates() const { return m_X != NULL; }
+	float GetX( unsigned int Node ) const { return m_X[Node]; }
+	float GetY( unsigned int Node ) const { return m_Y[Node]; }
+
+	// Optional node names, stored back to back in one character array
+	void SetNames( const vector< string > &Names )
+	{
+		m_NameOffsetStorage.assign( 1, 0 );
+		m_NameCharStorage.clear();
+
+		for( unsigned int n = 0; n < m_NodeCount; n ++ )
+		{
+			if( n < Names.size() )
+			{
+				m_NameCharStorage.insert( m_NameCharStorage.end(), Names[n].begin(), Names[n].end() );
+			}
+
+			m_NameOffsetStorage.push_back( (unsigned int)m_NameCharStorage.size() );
+		}
+
+		m_NameCharStorage.push_back( '\0' ); // so the array is never empty
+
+		m_NameOffsets = &m_NameOffsetStorage[0];
+		m_NameChars = &m_NameCharStorage[0];
+	}
+
+	bool HasNames() const { return m_NameOffsets != NULL; }
+
+	string GetName( unsigned int Node ) const
+	{
+		return string( m_NameChars + m_NameOffsets[Node], m_NameChars + m_NameOffsets[Node + 1] );
+	}
+
+	// Raw arrays, for writing the graph out and for code that wants to walk them directly
+	const unsigned int *GetOffsets() const { return m_Offsets; }
+	const unsigned int *GetTargets() const { return m_Targets; }
+	const float *GetWeights() const { return m_Weights; }
+	const float *GetXArray() const { return m_X; }
+	const float *GetYArray() const { return m_Y; }
+	const unsigned int *GetNameOffsets() const { return m_NameOffsets; }
+	const char *GetNameChars() const { return m_NameChars; }
+
+	// Landmark distances to use for EstimateDistance, NULL for none. The table must have been built for this graph.
+	void SetLandmarks( const LandmarkTable *Landmarks ) { m_Landmarks = Landmarks; }
+	const LandmarkTable *GetLandmarks() const { return m_Landmarks; }
+
+	// Lower bound on the cost from one node to another. The larger of the straight line distance, if there are
+	// coordinates, and the landmark estimate, if there are landmarks. 0 if the graph has neither.
+	float EstimateDistance( unsigned int From, unsigned int To ) const;
+
+	// EstimateDistance from each of the nodes From[0 .. Count) to To, into Estimates
+	void EstimateDistances( const unsigned int *From, unsigned int Count, unsigned int To, float *Estimates ) const;
+
+private:
+
+	// the views below point into the storage vectors, so the graph can't be copied
+	CSRGraph( const CSRGraph & );
+	CSRGraph &operator=( const CSRGraph & );
+
+	unsigned int m_NodeCount;
+	unsigned int m_EdgeCount;
+
+	const unsigned int *m_Offsets;
+	const unsigned int *m_Targets;
+	const float *m_Weights;
+	const float *m_X;
+	const float *m_Y;
+	const unsigned int *m_NameOffsets;
+	const char *m_NameChars;
+	const LandmarkTable *m_Landmarks;
+
+	vector< unsigned int > m_OffsetStorage;
+	vector< unsigned int > m_TargetStorage;
+	vector< float > m_WeightStorage;
+	vector< float > m_XStorage;
+	vector< float > m_YStorage;
+	vector< unsigned int > m_NameOffsetStorage;
+	vector< char > m_NameCharStorage;
+
+	// reverse adjacency, only there after BuildReverse
+	vector< unsigned int > m_ReverseOffsets;
+	vector< unsigned int > m_ReverseEdges;
+	vector< unsigned int > m_ReverseSources;
+};
+
+// UserState for searching a CSRGraph with AStarSearch. Successors are only the node's real out edges.
+// GetPredecessors, for AStarBidirectionalSearch, needs the graph's reverse adjacency from CSRGraph::BuildReverse.
+
+class CSRGraphNode
+{
+public:
+
+	const CSRGraph *m_Graph;
+	unsigned int m_Node;
+	unsigned int m_Edge; // the edge this state was generated through by GetSuccessors or GetPredecessors, lets GetCost skip the edge lookup
+
+	CSRGraphNode() : m_Graph( NULL ), m_Node( 0 ), m_Edge( 0 ) {}
+	CSRGraphNode( const CSRGraph *Graph, unsigned int Node ) : m_Graph( Graph ), m_Node( Node ), m_Edge( Graph->GetEdgeCount() ) {}
+
+	float GoalDistanceEstimate( CSRGraphNode &nodeGoal )
+	{
+		return m_Graph->EstimateDistance( m_Node, nodeGoal.m_Node );
+	}
+
+	bool IsGoal( CSRGraphNode &nodeGoal )
+	{
+		return m_Node == nodeGoal.m_Node;
+	}
+
+	template <class AStarSearchType> bool GetSuccessors( AStarSearchType *astarsearch, CSRGraphNode *parent_node )
+	{
+		typename AStarSearchType::UserStateType NewNode( m_Graph, 0 ); // a class derived from this one gets its own type back
+		unsigned int end = m_Graph->EdgesEnd( m_Node );
+
+		for( unsigned int e = m_Graph->EdgesBegin( m_Node ); e < end; e ++ )
+		{
+			NewNode.m_Node = m_Graph->GetEdgeTarget( e );
+			NewNode.m_Edge = e;
+
+			if( !astarsearch->AddSuccessor( NewNode ) )
+			{
+				return false; // out of node memory
+			}
+		}
+
+		return true;
+	}
+
+	template <class AStarSearchType> bool GetPredecessors( AStarSearchType *astarsearch, CSRGraphNode *parent_node )
+	{
+		typename AStarSearchType::UserStateType NewNode( m_Graph, 0 ); // a class derived from this one gets its own type back
+		unsigned int end = m_Graph->InEdgesEnd( m_Node );
+
+		for( unsigned int r = m_Graph->InEdgesBegin( m_Node ); r < end; r ++ )
+		{
+			NewNode.m_Node = m_Graph->GetInEdgeSource( r );
+			NewNode.m_Edge = m_Graph->GetInEdgeForward( r );
+
+			if( !astarsearch->AddSuccessor( NewNode ) )
+			{
+				return false; // out of node memory
+			}
+		}
+
+		return true;
+	}
+
+	float GetCost( CSRGraphNode &successor )
+	{
+		// this state was handed out as a predecessor of the successor, through the edge between them. Checked first,
+		// with parallel edges the successor may remember a different one of them.
+		if( m_Edge >= m_Graph->EdgesBegin( m_Node ) && m_Edge < m_Graph->EdgesEnd( m_Node ) &&
+			m_Graph->GetEdgeTarget( m_Edge ) == successor.m_Node )
+		{
+			return m_Graph->GetEdgeWeight( m_Edge );
+		}
+
+		// the successor remembers the edge it came through, unless it came from some other node
+		if( successor.m_Edge >= m_Graph->EdgesBegin( m_Node ) && successor.m_Edge < m_Graph->EdgesEnd( m_Node ) &&
+			m_Graph->GetEdgeTarget( successor.m_Edge ) == successor.m_Node )
+		{
+			return m_Graph->GetEdgeWeight( successor.m_Edge );
+		}
+
+		return m_Graph->GetEdgeWeight( m_Node, successor.m_Node );
+	}
+
+	bool IsSameState( CSRGraphNode &rhs )
+	{
+		return m_Node == rhs.m_Node;
+	}
+
+	size_t Hash()
+	{
+		return m_Node;
+	}
+
+	unsigned int Id()
+	{
+		return m_Node;
+	}
+
+	void PrintNodeInfo()
+	{
+		if( m_Graph->HasNames() )
+		{
+			cout << m_Graph->GetName( m_Node );
+		}
+		else
+		{
+			cout << m_Node;
+		}
+	}
+};
+
+// CSRGraphNode with a batched heuristic. The search hands it all the kept successors of a node at once and their
+// estimates are worked out together with CSREuclideanDistances. Whether that beats CSRGraphNode depends on how much
+// of the search time goes on the estimates, on a plain grid with Euclidean estimates the hash lookups dominate and
+// the extra pass over the successors makes it a little slower.
+
+class CSRGraphBatchNode : public CSRGraphNode
+{
+public:
+
+	CSRGraphBatchNode() {}
+	CSRGraphBatchNode( const CSRGraph *Graph, unsigned int Node ) : CSRGraphNode( Graph, Node ) {}
+
+	void GoalDistanceEstimateBatch( CSRGraphBatchNode *const *States, unsigned int Count, CSRGraphBatchNode &nodeGoal, float *Estimates )
+	{
+		const unsigned int Chunk = 64;
+		unsigned int nodes[Chunk]; // the successors' node numbers, the kernel gathers their coordinates
+
+		for( unsigned int i = 0; i < Count; i += Chunk )
+		{
+			unsigned int n = min( Chunk, Count - i );
+
+			for( unsigned int j = 0; j < n; j ++ )
+			{
+				nodes[j] = States[i + j]->m_Node;
+			}
+
+			m_Graph->EstimateDistances( nodes, n, nodeGoal.m_Node, Estimates + i );
+		}
+	}
+};
+
+// CSR Graph Ends -------------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Landmark Heuristic Code Starts ---------------------------------------------------------------------------------------------------------------
+
+// Runs Dijkstra from Source over every node of a graph, following edges backwards when Reverse is set (which needs
+// CSRGraph::BuildReverse). Distance[n] is left at FLT_MAX for nodes that can't be reached.
+void CSRGraphDijkstra( const CSRGraph &Graph, unsigned int Source, bool Reverse, vector< float > &Distance )
+{
+	typedef pair< float, unsigned int > Entry;
+
+	Distance.assign( Graph.GetNodeCount(), FLT_MAX );
+
+	vector< Entry > heap;
+	greater< Entry > compare;
+
+	Distance[Source] = 0.0f;
+	heap.push_back( Entry( 0.0f, Source ) );
+
+	while( !heap.empty() )
+	{
+		pop_heap( heap.begin(), heap.end(), compare );
+		Entry top = heap.back();
+		heap.pop_back();
+
+		unsigned int n = top.second;
+
+		if( top.first > Distance[n] )
+		{
+			continue; // stale entry, n was reached more cheaply since
+		}
+
+		unsigned int begin = Reverse ? Graph.InEdgesBegin( n ) : Graph.EdgesBegin( n );
+		unsigned int end = Reverse ? Graph.InEdgesEnd( n ) : Graph.EdgesEnd( n );
+
+		for( unsigned int e = begin; e < end; e ++ )
+		{
+			unsigned int edge = Reverse ? Graph.GetInEdgeForward( e ) : e;
+			unsigned int next = Reverse ? Graph.GetInEdgeSource( e ) : Graph.GetEdgeTarget( e );
+			float d = top.first + Graph.GetEdgeWeight( edge );
+
+			if( d < Distance[next] )
+			{
+				Distance[next] = d;
+				heap.push_back( Entry( d, next ) );
+				push_heap( heap.begin(), heap.end(), compare );
+			}
+		}
+	}
+}
+
+// ALT (A*, landmarks and the triangle inequality) heuristic. A few landmark nodes are picked and the exact cost from
+// every landmark to every node and from every node to every landmark is stored. For any landmark L the triangle
+// inequality gives two lower bounds on the cost from n to t,
+//
+//   d(L, t) - d(L, n)   and   d(n, L) - d(t, L)
+//
+// and the estimate is the largest of them over all landmarks. It is admissible and consistent for any goal, and
+// attached to a CSRGraph it is what CSRGraph::EstimateDistance returns.
+
+class LandmarkTable
+{
+public:
+
+	LandmarkTable() :
+		m_NodeCount( 0 ),
+		m_LandmarkCount( 0 )
+	{
+	}
+
+	// Picks Count landmarks and runs the 2 * Count Dijkstra searches to fill the tables. Landmarks are chosen farthest
+	// first, each new one being the node farthest from those already picked, which puts them around the edge of the
+	// graph where their bounds are tightest. Builds the graph's reverse adjacency if it does not have one.
+	void Build( CSRGraph &Graph, unsigned int Count )
+	{
+		if( !Graph.HasReverse() )
+		{
+			Graph.BuildReverse();
+		}
+
+		m_NodeCount = Graph.GetNodeCount();
+		m_LandmarkCount = 0;
+		m_Landmarks.clear();
+
+		if( m_NodeCount == 0 )
+		{
+			return;
+		}
+
+		if( Count > m_NodeCount )
+		{
+			Count = m_NodeCount;
+		}
+
+		m_From.assign( (size_t)m_NodeCount * Count, FLT_MAX );
+		m_To.assign( (size_t)m_NodeCount * Count, FLT_MAX );
+
+		vector< float > nearest( m_NodeCount, FLT_MAX ); // cost from the closest landmark picked so far
+		vector< float > distance;
+
+		// start from whatever is farthest from node 0
+		CSRGraphDijkstra( Graph, 0, false, distance );
+		unsigned int landmark = Farthest( distance, nearest );
+
+		for( unsigned int k = 0; k < Count; k ++ )
+		{
+			m_Landmarks.push_back( landmark );
+
+			CSRGraphDijkstra( Graph, landmark, false, distance );
+
+			for( unsigned int n = 0; n < m_NodeCount; n ++ )
+			{
+				m_From[ (size_t)n * Count + k ] = distance[n];
+
+				if( distance[n] < nearest[n] )
+				{
+					nearest[n] = distance[n];
+				}
+			}
+
+			CSRGraphDijkstra( Graph, landmark, true, distance );
+
+			for( unsigned int n = 0; n < m_NodeCount; n ++ )
+			{
+				m_To[ (size_t)n * Count + k ] = distance[n];
+			}
+
+			landmark = Farthest( nearest, nearest );
+		}
+
+		m_LandmarkCount = Count;
+	}
+
+	// Lower bound on the cost of getting from From to To
+	float Estimate( unsigned int From, unsigned int To ) const
+	{
+		// nothing built, and the tables are empty so there is nothing to index into
+		if( m_LandmarkCount == 0 )
+		{
+			return 0.0f;
+		}
+
+		const float *fromFrom = &m_From[ (size_t)From * m_LandmarkCount ];
+		const float *fromTo = &m_From[ (size_t)To * m_LandmarkCount ];
+		const float *toFrom = &m_To[ (size_t)From * m_LandmarkCount ];
+		const float *toTo = &m_To[ (size_t)To * m_LandmarkCount ];
+
+		float best = 0.0f;
+
+		for( unsigned int k = 0; k < m_LandmarkCount; k ++ )
+		{
+			// a landmark that can't reach, or be reached from, either node gives no bound
+			if( fromTo[k] != FLT_MAX && fromFrom[k] != FLT_MAX && fromTo[k] - fromFrom[k] > best )
+			{
+				best = fromTo[k] - fromFrom[k];
+			}
+
+			if( toFrom[k] != FLT_MAX && toTo[k] != FLT_MAX && toFrom[k] - toTo[k] > best )
+			{
+				best = toFrom[k] - toTo[k];
+			}
+		}
+
+		return best;
+	}
+
+	unsigned int GetLandmarkCount() const { return m_LandmarkCount; }
+	unsigned int GetLandmark( unsigned int k ) const { return m_Landmarks[k]; }
+
+private:
+
+	// The reachable node with the largest Distance that is not a landmark already, Nearest rules out the landmarks
+	unsigned int Farthest( const vector< float > &Distance, const vector< float > &Nearest ) const
+	{
+		unsigned int best = m_Landmarks.empty() ? 0 : m_Landmarks[0];
+		float bestDistance = -1.0f;
+
+		for( unsigned int n = 0; n < m_NodeCount; n ++ )
+		{
+			if( Distance[n] != FLT_MAX && Nearest[n] != 0.0f && Distance[n] > bestDistance )
+			{
+				best = n;
+				bestDistance = Distance[n];
+			}
+		}
+
+		return best;
+	}
+
+	unsigned int m_NodeCount;
+	unsigned int m_LandmarkCount;
+	vector< unsigned int > m_Landmarks;
+
+	// node major, the Count entries for a node sit together so one estimate reads two short runs
+	vector< float > m_From; // cost from landmark k to node n at [ n * Count + k ]
+	vector< float > m_To; // cost from node n to landmark k at [ n * Count + k ]
+};
+
+inline float CSRGraph::EstimateDistance( unsigned int From, unsigned int To ) const
+{
+	float estimate = 0.0f;
+
+	if( m_X )
+	{
+		float dx = m_X[From] - m_X[To];
+		float dy = m_Y[From] - m_Y[To];
+
+		estimate = sqrtf( dx * dx + dy * dy );
+	}
+
+	if( m_Landmarks )
+	{
+		estimate = max( estimate, m_Landmarks->Estimate( From, To ) );
+	}
+
+	return estimate;
+}
+
+inline void CSRGraph::EstimateDistances( const unsigned int *From, unsigned int Count, unsigned int To, float *Estimates ) const
+{
+	if( m_X )
+	{
+		CSREuclideanDistances( m_X, m_Y, From, Count, m_X[To], m_Y[To], Estimates );
+	}
+	else
+	{
+		fill( Estimates, Estimates + Count, 0.0f );
+	}
+
+	if( m_Landmarks )
+	{
+		for( unsigned int i = 0; i < Count; i ++ )
+		{
+			Estimates[i] = max( Estimates[i], m_Landmarks->Estimate( From[i], To ) );
+		}
+	}
+}
+
+// Landmark Heuristic Ends ----------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Graph File Code Starts -----------------------------------------------------------------------------------------------------------------------
+
+// Binary graph file. A fixed header is followed by the CSR arrays, each starting on an 8 byte boundary, so once the
+// file is mapped the arrays are used where they lie with no parsing. Mapped read only and shared, the pages are
+// loaded on demand and shared by every process that maps the same file. Files are written in the byte order of the
+// machine that wrote them and are rejected on a machine with the other byte order.
+//
+//   header | offsets uint32[V + 1] | targets uint32[E] | weights float[E] | x float[V] | y float[V] | name offsets uint32[V + 1] | name chars
+
+enum
+{
+	GRAPH_FILE_VERSION = 1,
+	GRAPH_FILE_BYTE_ORDER = 0x01020304,
+
+	GRAPH_FILE_COORDINATES = 1,
+	GRAPH_FILE_NAMES = 2,
+};
+
+class GraphFileHeader
+{
+public:
+
+	char magic[8]; // "ASTARGRF"
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t nodeCount;
+	uint32_t edgeCount;
+	uint32_t flags;
+	uint32_t reserved;
+
+	// byte offsets of each array from the start of the file, 0 for arrays that are not present
+	uint64_t offsetsAt;
+	uint64_t targetsAt;
+	uint64_t weightsAt;
+	uint64_t xAt;
+	uint64_t yAt;
+	uint64_t nameOffsetsAt;
+	uint64_t nameCharsAt;
+	uint64_t nameCharCount;
+	uint64_t fileSize;
+};
+
+static const char GraphFileMagic[8] = { 'A', 'S', 'T', 'A', 'R', 'G', 'R', 'F' };
+
+// Lays out one array of the file, returns where it starts
+static uint64_t GraphFileSection( uint64_t &End, uint64_t Bytes )
+{
+	uint64_t at = (End + 7) & ~(uint64_t)7;
+	End = at + Bytes;
+	return at;
+}
+
+static void GraphFileWriteAt( ofstream &File, uint64_t At, const void *Data, uint64_t Bytes )
+{
+	if( Bytes )
+	{
+		File.seekp( (streamoff)At );
+		File.write( static_cast< const char * >( Data ), (streamsize)Bytes );
+	}
+}
+
+// Writes a graph, with its coordinates and names if it has them, returns false if the file could not be written
+bool WriteGraphFile( const char *Path, const CSRGraph &Graph )
+{
+	uint64_t V = Graph.GetNodeCount();
+	uint64_t E = Graph.GetEdgeCount();
+
+	GraphFileHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, GraphFileMagic, sizeof( header.magic ) );
+	header.version = GRAPH_FILE_VERSION;
+	header.byteOrder = GRAPH_FILE_BYTE_ORDER;
+	header.nodeCount = (uint32_t)V;
+	header.edgeCount = (uint32_t)E;
+
+	uint64_t end = sizeof( header );
+
+	header.offsetsAt = GraphFileSection( end, (V + 1) * sizeof( uint32_t ) );
+	header.targetsAt = GraphFileSection( end, E * sizeof( uint32_t ) );
+	header.weightsAt = GraphFileSection( end, E * sizeof( float ) );
+
+	if( Graph.HasCoordinates() )
+	{
+		header.flags |= GRAPH_FILE_COORDINATES;
+		header.xAt = GraphFileSection( end, V * sizeof( float ) );
+		header.yAt = GraphFileSection( end, V * sizeof( float ) );
+	}
+
+	if( Graph.HasNames() )
+	{
+		header.flags |= GRAPH_FILE_NAMES;
+		header.nameCharCount = Graph.GetNameOffsets()[V];
+		header.nameOffsetsAt = GraphFileSection( end, (V + 1) * sizeof( uint32_t ) );
+		header.nameCharsAt = GraphFileSection( end, header.nameCharCount + 1 );
+	}
+
+	header.fileSize = end;
+
+	ofstream file( Path, ios::out | ios::binary | ios::trunc );
+
+	if( !file )
+	{
+		return false;
+	}
+
+	GraphFileWriteAt( file, 0, &header, sizeof( header ) );
+	GraphFileWriteAt( file, header.offsetsAt, Graph.GetOffsets(), (V + 1) * sizeof( uint32_t ) );
+	GraphFileWriteAt( file, header.targetsAt, Graph.GetTargets(), E * sizeof( uint32_t ) );
+	GraphFileWriteAt( file, header.weightsAt, Graph.GetWeights(), E * sizeof( float ) );
+
+	if( header.flags & GRAPH_FILE_COORDINATES )
+	{
+		GraphFileWriteAt( file, header.xAt, Graph.GetXArray(), V * sizeof( float ) );
+		GraphFileWriteAt( file, header.yAt, Graph.GetYArray(), V * sizeof( float ) );
+	}
+
+	if( header.flags & GRAPH_FILE_NAMES )
+	{
+		GraphFileWriteAt( file, header.nameOffsetsAt, Graph.GetNameOffsets(), (V + 1) * sizeof( uint32_t ) );
+		GraphFileWriteAt( file, header.nameCharsAt, Graph.GetNameChars(), header.nameCharCount + 1 );
+	}
+
+	return (bool)file;
+}
+
+// A graph file mapped into memory. The graph's arrays point straight into the mapping.
+
+class MappedGraphFile
+{
+public:
+
+	MappedGraphFile() :
+		m_Base( NULL ),
+		m_Size( 0 )
+	{
+	}
+
+	~MappedGraphFile()
+	{
+		Close();
+	}
+
+	// Maps the file and checks its header, returns false if it can't be opened or is not a valid graph file.
+	// Only the header and the array bounds are checked, the arrays themselves are trusted so opening stays O(1).
+	bool Open( const char *Path )
+	{
+		Close();
+
+		int fd = open( Path, O_RDONLY );
+
+		if( fd < 0 )
+		{
+			return false;
+		}
+
+		struct stat info;
+
+		if( fstat( fd, &info ) != 0 || (uint64_t)info.st_size < sizeof( GraphFileHeader ) )
+		{
+			close( fd );
+			return false;
+		}
+
+		void *base = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+		close( fd ); // the mapping keeps the file open
+
+		if( base == MAP_FAILED )
+		{
+			return false;
+		}
+
+		m_Base = static_cast< char * >( base );
+		m_Size = (size_t)info.st_size;
+
+		if( !Validate() )
+		{
+			Close();
+			return false;
+		}
+
+		const GraphFileHeader *header = reinterpret_cast< const GraphFileHeader * >( m_Base );
+
+		m_Graph.Attach( header->nodeCount, header->edgeCount,
+			Array< unsigned int >( header->offsetsAt ), Array< unsigned int >( header->targetsAt ), Array< float >( header->weightsAt ),
+			Array< float >( header->xAt ), Array< float >( header->yAt ),
+			Array< unsigned int >( header->nameOffsetsAt ), Array< char >( header->nameCharsAt ) );
+
+		return true;
+	}
+
+	void Close()
+	{
+		if( m_Base )
+		{
+			munmap( m_Base, m_Size );
+			m_Base = NULL;
+			m_Size = 0;
+			m_Graph.Attach( 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL );
+		}
+	}
+
+	const CSRGraph &GetGraph() const { return m_Graph; }
+	CSRGraph &GetGraph() { return m_Graph; } // for building in memory extras such as the reverse adjacency
+
+private:
+
+	template <class T> const T *Array( uint64_t At ) const
+	{
+		return At ? reinterpret_cast< const T * >( m_Base + At ) : NULL;
+	}
+
+	bool Fits( uint64_t At, uint64_t Bytes ) const
+	{
+		return (At % 8) == 0 && At >= sizeof( GraphFileHeader ) && At <= m_Size && Bytes <= m_Size - At;
+	}
+
+	bool Validate() const
+	{
+		const GraphFileHeader *header = reinterpret_cast< const GraphFileHeader * >( m_Base );
+
+		if( memcmp( header->magic, GraphFileMagic, sizeof( header->magic ) ) != 0 ||
+			header->version != GRAPH_FILE_VERSION ||
+			header->byteOrder != GRAPH_FILE_BYTE_ORDER ||
+			header->fileSize > m_Size )
+		{
+			return false;
+		}
+
+		uint64_t V = header->nodeCount;
+		uint64_t E = header->edgeCount;
+
+		if( !Fits( header->offsetsAt, (V + 1) * sizeof( uint32_t ) ) ||
+			!Fits( header->targetsAt, E * sizeof( uint32_t ) ) ||
+			!Fits( header->weightsAt, E * sizeof( float ) ) )
+		{
+			return false;
+		}
+
+		if( (header->flags & GRAPH_FILE_COORDINATES) &&
+			(!Fits( header->xAt, V * sizeof( float ) ) || !Fits( header->yAt, V * sizeof( float ) )) )
+		{
+			return false;
+		}
+
+		if( (header->flags & GRAPH_FILE_NAMES) &&
+			(!Fits( header->nameOffsetsAt, (V + 1) * sizeof( uint32_t ) ) || !Fits( header->nameCharsAt, header->nameCharCount + 1 ) ||
+			 Array< unsigned int >( header->nameOffsetsAt )[V] != header->nameCharCount) )
+		{
+			return false;
+		}
+
+		return Array< unsigned int >( header->offsetsAt )[V] == E;
+	}
+
+	// the graph points into the mapping, so the file can't be copied
+	MappedGraphFile( const MappedGraphFile & );
+	MappedGraphFile &operator=( const MappedGraphFile & );
+
+	char *m_Base;
+	size_t m_Size;
+	CSRGraph m_Graph;
+};
+
+// Converts a plain text graph into a graph file. Blank lines and lines starting with # are skipped. Every other line is
+//
+//   <from> <to> <weight>         an edge, the "e" prefix is optional
+//   v <node> <x> <y> [name]      coordinates and an optional name for a node
+//
+// Nodes are numbered from 0 and the node count is one more than the highest node mentioned. If any coordinates are
+// given the file gets coordinates for every node (0, 0 where none were given), the same for names.
+bool ConvertEdgeListToGraphFile( const char *TextPath, const char *GraphPath, string &Error )
+{
+	ifstream text( TextPath );
+
+	if( !text )
+	{
+		Error = string( "can't open " ) + TextPath;
+		return false;
+	}
+
+	vector< CSREdge > edges;
+	vector< float > x, y;
+	vector< string > names;
+	unsigned int nodeCount = 0;
+	bool hasCoordinates = false, hasNames = false;
+	string line;
+	unsigned int lineNumber = 0;
+
+	while( getline( text, line ) )
+	{
+		lineNumber ++;
+
+		const char *p = line.c_str();
+
+		while( *p == ' ' || *p == '\t' ) p ++;
+
+		if( *p == '\0' || *p == '#' || *p == '\r' )
+		{
+			continue;
+		}
+
+		char *end;
+
+		if( *p == 'v' )
+		{
+			unsigned long node = strtoul( p + 1, &end, 10 );
+			p = end;
+			float nx = strtof( p, &end );
+			bool ok = end != p;
+			p = end;
+			float ny = strtof( p, &end );
+			ok = ok && end != p;
+			p = end;
+
+			if( !ok )
+			{
+				Error = "bad line " + to_string( lineNumber ) + ": " + line;
+				return false;
+			}
+
+			if( node >= x.size() )
+			{
+				x.resize( node + 1, 0.0f );
+				y.resize( node + 1, 0.0f );
+				names.resize( node + 1 );
+			}
+
+			x[node] = nx;
+			y[node] = ny;
+			hasCoordinates = true;
+
+			while( *p == ' ' || *p == '\t' ) p ++;
+
+			string name( p );
+
+			while( !name.empty() && (name[name.size() - 1] == '\r' || name[name.size() - 1] == ' ') )
+			{
+				name.erase( name.size() - 1 );
+			}
+
+			if( !name.empty() )
+			{
+				names[node] = name;
+				hasNames = true;
+			}
+
+			nodeCount = max( nodeCount, (unsigned int)node + 1 );
+			continue;
+		}
+
+		if( *p == 'e' )
+		{
+			p ++;
+		}
+
+		CSREdge edge;
+		edge.from = (unsigned int)strtoul( p, &end, 10 );
+		bool ok = end != p;
+		p = end;
+		edge.to = (unsigned int)strtoul( p, &end, 10 );
+		ok = ok && end != p;
+		p = end;
+		edge.weight = strtof( p, &end );
+		ok = ok && end != p;
+
+		if( !ok )
+		{
+			Error = "bad line " + to_string( lineNumber ) + ": " + line;
+			return false;
+		}
+
+		edges.push_back( edge );
+		nodeCount = max( nodeCount, max( edge.from, edge.to ) + 1 );
+	}
+
+	if( text.bad() )
+	{
+		Error = string( "can't read " ) + TextPath;
+		return false;
+	}
+
+	CSRGraph graph;
+	graph.Build( nodeCount, edges );
+
+	if( hasCoordinates )
+	{
+		x.resize( nodeCount, 0.0f );
+		y.resize( nodeCount, 0.0f );
+		graph.SetCoordinates( x, y );
+	}
+
+	if( hasNames )
+	{
+		graph.SetNames( names );
+	}
+
+	if( !WriteGraphFile( GraphPath, graph ) )
+	{
+		Error = string( "can't write " ) + GraphPath;
+		return false;
+	}
+
+	return true;
+}
+
+// Graph File Ends ------------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Contraction Hierarchy Code Starts ------------------------------------------------------------------------------------------------------------
+
+// Contraction hierarchies trade an offline preprocessing step for point to point queries that take microseconds on
+// graphs where A* takes milliseconds. Nodes are contracted one at a time, least important first. Contracting a node
+// takes it out of the graph, and wherever a shortest path ran u -> v -> w through it a shortcut u -> w is added with
+// the cost of both edges, unless a witness search finds another path from u to w that is no longer. The position a
+// node is contracted at is its rank.
+//
+// Every edge, original or shortcut, then climbs from its lower ranked end to its higher, and some shortest path
+// between any two nodes climbs from the start to a top node and descends from there to the goal. A query runs
+// Dijkstra upwards from the start over the edges that climb and upwards from the goal over the edges that descend,
+// each search settling a few hundred nodes on road like graphs, and joins the two at the best meeting node. Each
+// shortcut remembers the node it bypasses, so the path is unpacked back into the original nodes.
+//
+// The hierarchy is only valid for the edge weights it was built with, graphs whose weights change are what
+// AStarLPASearch is for.
+
+class ContractionHierarchy
+{
+public:
+
+	enum { NO_NODE = 0xffffffff };
+
+	// An edge of the hierarchy, stored at its lower ranked end. Node is the higher ranked end, the target of an upward
+	// edge or the source of a downward one.
+	class Edge
+	{
+	public:
+
+		uint32_t node;
+		float weight;
+		uint32_t middle; // the node a shortcut bypasses, NO_NODE for an edge of the graph
+	};
+
+	ContractionHierarchy() :
+		m_NodeCount( 0 ),
+		m_ShortcutCount( 0 ),
+		m_Generation( 1 ),
+		m_SettledCount( 0 )
+	{
+	}
+
+	// Contracts every node of the graph. Each witness search gives up after settling WitnessLimit nodes and the
+	// shortcut is added anyway, which can only cost query time, never correctness.
+	void Build( const CSRGraph &Graph, unsigned int WitnessLimit = 500 );
+
+	// Writes the hierarchy to a file, returns false if the file could not be written
+	bool Save( const char *Path ) const;
+
+	// Reads a hierarchy written by Save, returns false if the file can't be read or is not a hierarchy file
+	bool Load( const char *Path );
+
+	// Returns the cost of the shortest path from From to To, or FLT_MAX if there is none, and fills Path with the
+	// nodes along it from From to To. Queries reuse their working arrays and do not allocate once warm.
+	float Query( unsigned int From, unsigned int To, vector< unsigned int > &Path );
+
+	unsigned int GetNodeCount() const { return m_NodeCount; }
+	size_t GetEdgeCount() const { return m_UpEdges.size() + m_DownEdges.size(); }
+	size_t GetShortcutCount() const { return m_ShortcutCount; }
+	unsigned int GetSettledCount() const { return m_SettledCount; } // nodes settled by the last query, both directions
+
+private:
+
+	typedef pair< float, unsigned int > HeapEntry;
+
+	// One of the two searches of a query. Every array is indexed by node and stamped with the generation of the query
+	// that last reached the node, so a query never clears them.
+	class Direction
+	{
+	public:
+
+		vector< float > m_Distance;
+		vector< unsigned int > m_Parent; // the node the search reached this one from, NO_NODE at its root
+		vector< unsigned int > m_ParentEdge; // index of the edge it was reached over
+		vector< unsigned int > m_Stamp;
+		vector< HeapEntry > m_Heap;
+	};
+
+	// A shortcut found by Simulate, waiting to be added
+	class Shortcut
+	{
+	public:
+
+		unsigned int from;
+		Edge edge;
+	};
+
+	// The graph while it is being contracted, holding only the nodes not yet contracted
+	class Remaining
+	{
+	public:
+
+		vector< vector< Edge > > m_Out;
+		vector< vector< Edge > > m_In; // node is the source
+		vector< unsigned int > m_ContractedNeighbours;
+
+		// witness search
+		vector< float > m_Distance;
+		vector< unsigned int > m_Touched;
+		vector< HeapEntry > m_Heap;
+		unsigned int m_WitnessLimit;
+	};
+
+	static void AddArc( Remaining &Graph, unsigned int From, const Edge &Arc );
+	static void Witness( Remaining &Graph, unsigned int Source, unsigned int Avoid, float MaxCost );
+	static int Simulate( Remaining &Graph, unsigned int Node, vector< Shortcut > &Shortcuts );
+
+	void Reset( unsigned int NodeCount );
+	void Reach( Direction &Search, unsigned int Node, float Distance, unsigned int Parent, unsigned int ParentEdge );
+	bool Reached( const Direction &Search, unsigned int Node ) const { return Search.m_Stamp[Node] == m_Generation; }
+	unsigned int FindMiddle( const vector< unsigned int > &Offsets, const vector< Edge > &Edges, unsigned int At, unsigned int Node ) const;
+	void Unpack( unsigned int From, unsigned int To, unsigned int Middle, vector< unsigned int > &Path );
+
+	unsigned int m_NodeCount;
+	size_t m_ShortcutCount;
+
+	// Upward edges of node n at [ m_UpOffsets[n], m_UpOffsets[n + 1] ), edges n -> m to higher ranked nodes m.
+	// Downward edges likewise, edges m -> n from higher ranked nodes m.
+	vector< unsigned int > m_UpOffsets;
+	vector< Edge > m_UpEdges;
+	vector< unsigned int > m_DownOffsets;
+	vector< Edge > m_DownEdges;
+
+	// query state
+	Direction m_Forward;
+	Direction m_Backward;
+	vector< Shortcut > m_Unpack;
+	unsigned int m_Generation;
+	unsigned int m_SettledCount;
+};
+
+// Adds an edge to the remaining graph, or lowers the weight of the edge already there
+void ContractionHierarchy::AddArc( Remaining &Graph, unsigned int From, const Edge &Arc )
+{
+	vector< Edge > &out = Graph.m_Out[From];
+
+	for( size_t i = 0; i < out.size(); i ++ )
+	{
+		if( out[i].node == Arc.node )
+		{
+			if( Arc.weight < out[i].weight )
+			{
+				out[i].weight = Arc.weight;
+				out[i].middle = Arc.middle;
+
+				vector< Edge > &in = Graph.m_In[Arc.node];
+
+				for( size_t j = 0; j < in.size(); j ++ )
+				{
+					if( in[j].node == From )
+					{
+						in[j].weight = Arc.weight;
+						in[j].middle = Arc.middle;
+						break;
+					}
+				}
+			}
+
+			return;
+		}
+	}
+
+	Edge reverse = Arc;
+	reverse.node = From;
+
+	out.push_back( Arc );
+	Graph.m_In[Arc.node].push_back( reverse );
+}
+
+// Dijkstra from Source over the remaining graph without Avoid, stopping once nothing closer than MaxCost is left or
+// the witness limit is reached. Leaves the costs in Graph.m_Distance, the caller resets the touched entries.
+void ContractionHierarchy::Witness( Remaining &Graph, unsigned int Source, unsigned int Avoid, float MaxCost )
+{
+	greater< HeapEntry > compare;
+	unsigned int settled = 0;
+
+	Graph.m_Heap.clear();
+	Graph.m_Distance[Source] = 0.0f;
+	Graph.m_Touched.push_back( Source );
+	Graph.m_Heap.push_back( HeapEntry( 0.0f, Source ) );
+
+	while( !Graph.m_Heap.empty() )
+	{
+		pop_heap( Graph.m_Heap.begin(), Graph.m_Heap.end(), compare );
+		HeapEntry top = Graph.m_Heap.back();
+		Graph.m_Heap.pop_back();
+
+		if( top.first > Graph.m_Distance[top.second] )
+		{
+			continue; // stale entry
+		}
+
+		if( top.first > MaxCost || ++ settled > Graph.m_WitnessLimit )
+		{
+			break;
+		}
+
+		const vector< Edge > &out = Graph.m_Out[top.second];
+
+		for( size_t i = 0; i < out.size(); i ++ )
+		{
+			unsigned int next = out[i].node;
+			float d = top.first + out[i].weight;
+
+			if( next != Avoid && d < Graph.m_Distance[next] )
+			{
+				if( Graph.m_Distance[next] == FLT_MAX )
+				{
+					Graph.m_Touched.push_back( next );
+				}
+
+				Graph.m_Distance[next] = d;
+				Graph.m_Heap.push_back( HeapEntry( d, next ) );
+				push_heap( Graph.m_Heap.begin(), Graph.m_Heap.end(), compare );
+			}
+		}
+	}
+}
+
+// Finds the shortcuts contracting Node would need and returns its priority, lower is contracted sooner. The
+// priority is twice the edge difference, the shortcuts added less the edges removed, which keeps the hierarchy
+// sparse, plus the neighbours already contracted, which spreads contraction evenly over the graph.
+int ContractionHierarchy::Simulate( Remaining &Graph, unsigned int Node, vector< Shortcut > &Shortcuts )
+{
+	const vector< Edge > &in = Graph.m_In[Node];
+	const vector< Edge > &out = Graph.m_Out[Node];
+
+	Shortcuts.clear();
+
+	for( size_t i = 0; i < in.size(); i ++ )
+	{
+		unsigned int from = in[i].node;
+		float maxCost = -1.0f;
+
+		for( size_t j = 0; j < out.size(); j ++ )
+		{
+			if( out[j].node != from )
+			{
+				maxCost = max( maxCost, in[i].weight + out[j].weight );
+			}
+		}
+
+		if( maxCost < 0.0f )
+		{
+			continue;
+		}
+
+		Witness( Graph, from, Node, maxCost );
+
+		for( size_t j = 0; j < out.size(); j ++ )
+		{
+			float cost = in[i].weight + out[j].weight;
+
+			if( out[j].node != from && Graph.m_Distance[ out[j].node ] > cost )
+			{
+				Shortcut shortcut;
+				shortcut.from = from;
+				shortcut.edge.node = out[j].node;
+				shortcut.edge.weight = cost;
+				shortcut.edge.middle = Node;
+				Shortcuts.push_back( shortcut );
+			}
+		}
+
+		for( size_t t = 0; t < Graph.m_Touched.size(); t ++ )
+		{
+			Graph.m_Distance[ Graph.m_Touched[t] ] = FLT_MAX;
+		}
+
+		Graph.m_Touched.clear();
+	}
+
+	return 2 * ( (int)Shortcuts.size() - (int)( in.size() + out.size() ) ) + (int)Graph.m_ContractedNeighbours[Node];
+}
+
+void ContractionHierarchy::Build( const CSRGraph &Graph, unsigned int WitnessLimit )
+{
+	typedef pair< int, unsigned int > QueueEntry;
+
+	unsigned int V = Graph.GetNodeCount();
+
+	Remaining remaining;
+	remaining.m_Out.resize( V );
+	remaining.m_In.resize( V );
+	remaining.m_ContractedNeighbours.assign( V, 0 );
+	remaining.m_Distance.assign( V, FLT_MAX );
+	remaining.m_WitnessLimit = WitnessLimit;
+
+	// parallel edges collapse to the cheapest, loops never lie on a shortest path
+	for( unsigned int n = 0; n < V; n ++ )
+	{
+		for( unsigned int e = Graph.EdgesBegin( n ); e < Graph.EdgesEnd( n ); e ++ )
+		{
+			if( Graph.GetEdgeTarget( e ) != n )
+			{
+				Edge arc;
+				arc.node = Graph.GetEdgeTarget( e );
+				arc.weight = Graph.GetEdgeWeight( e );
+				arc.middle = NO_NODE;
+				AddArc( remaining, n, arc );
+			}
+		}
+	}
+
+	// the edges each node has left when it is contracted, all of them to higher ranked nodes
+	vector< vector< Edge > > up( V );
+	vector< vector< Edge > > down( V );
+
+	vector< bool > contracted( V, false );
+	vector< int > priority( V );
+	vector< QueueEntry > queue;
+	vector< Shortcut > shortcuts;
+	greater< QueueEntry > compare;
+
+	for( unsigned int n = 0; n < V; n ++ )
+	{
+		priority[n] = Simulate( remaining, n, shortcuts );
+		queue.push_back( QueueEntry( priority[n], n ) );
+	}
+
+	make_heap( queue.begin(), queue.end(), compare );
+
+	while( !queue.empty() )
+	{
+		pop_heap( queue.begin(), queue.end(), compare );
+		QueueEntry top = queue.back();
+		queue.pop_back();
+
+		unsigned int node = top.second;
+
+		if( contracted[node] || top.first != priority[node] )
+		{
+			continue; // stale entry
+		}
+
+		// priorities are only brought up to date when they reach the front of the queue, if this one has gone up since
+		// it was queued and is no longer the lowest it goes back. Recomputing the neighbours of every contracted node
+		// instead builds the same hierarchy several times slower.
+		priority[node] = Simulate( remaining, node, shortcuts );
+
+		if( !queue.empty() && priority[node] > queue.front().first )
+		{
+			queue.push_back( QueueEntry( priority[node], node ) );
+			push_heap( queue.begin(), queue.end(), compare );
+			continue;
+		}
+
+		contracted[node] = true;
+		up[node].swap( remaining.m_Out[node] );
+		down[node].swap( remaining.m_In[node] );
+
+		for( size_t i = 0; i < shortcuts.size(); i ++ )
+		{
+			AddArc( remaining, shortcuts[i].from, shortcuts[i].edge );
+		}
+
+		// take the node out of its neighbours' edges
+		for( int direction = 0; direction < 2; direction ++ )
+		{
+			const vector< Edge > &edges = direction ? down[node] : up[node];
+
+			for( size_t i = 0; i < edges.size(); i ++ )
+			{
+				unsigned int neighbour = edges[i].node;
+				vector< Edge > &back = direction ? remaining.m_Out[neighbour] : remaining.m_In[neighbour];
+
+				for( size_t j = 0; j < back.size(); j ++ )
+				{
+					if( back[j].node == node )
+					{
+						back[j] = back.back();
+						back.pop_back();
+						break;
+					}
+				}
+
+				remaining.m_ContractedNeighbours[neighbour] ++;
+			}
+		}
+	}
+
+	// flatten into the query arrays
+	m_UpOffsets.assign( 1, 0 );
+	m_DownOffsets.assign( 1, 0 );
+	m_UpEdges.clear();
+	m_DownEdges.clear();
+	m_ShortcutCount = 0;
+
+	for( unsigned int n = 0; n < V; n ++ )
+	{
+		m_UpEdges.insert( m_UpEdges.end(), up[n].begin(), up[n].end() );
+		m_DownEdges.insert( m_DownEdges.end(), down[n].begin(), down[n].end() );
+		m_UpOffsets.push_back( (unsigned int)m_UpEdges.size() );
+		m_DownOffsets.push_back( (unsigned int)m_DownEdges.size() );
+	}
+
+	for( size_t e = 0; e < m_UpEdges.size(); e ++ )
+	{
+		m_ShortcutCount += m_UpEdges[e].middle != NO_NODE;
+	}
+
+	for( size_t e = 0; e < m_DownEdges.size(); e ++ )
+	{
+		m_ShortcutCount += m_DownEdges[e].middle != NO_NODE;
+	}
+
+	Reset( V );
+}
+
+// Sizes the query arrays for a hierarchy of NodeCount nodes
+void ContractionHierarchy::Reset( unsigned int NodeCount )
+{
+	m_NodeCount = NodeCount;
+	m_Generation = 1;
+
+	Direction *searches[2] = { &m_Forward, &m_Backward };
+
+	for( int i = 0; i < 2; i ++ )
+	{
+		searches[i]->m_Distance.assign( NodeCount, FLT_MAX );
+		searches[i]->m_Parent.assign( NodeCount, (unsigned int)NO_NODE );
+		searches[i]->m_ParentEdge.assign( NodeCount, (unsigned int)NO_NODE );
+		searches[i]->m_Stamp.assign( NodeCount, 0u );
+		searches[i]->m_Heap.clear();
+	}
+}
+
+inline void ContractionHierarchy::Reach( Direction &Search, unsigned int Node, float Distance, unsigned int Parent, unsigned int ParentEdge )
+{
+	Search.m_Stamp[Node] = m_Generation;
+	Search.m_Distance[Node] = Distance;
+	Search.m_Parent[Node] = Parent;
+	Search.m_ParentEdge[Node] = ParentEdge;
+	Search.m_Heap.push_back( HeapEntry( Distance, Node ) );
+	push_heap( Search.m_Heap.begin(), Search.m_Heap.end(), greater< HeapEntry >() );
+}
+
+float ContractionHierarchy::Query( unsigned int From, unsigned int To, vector< unsigned int > &Path )
+{
+	greater< HeapEntry > compare;
+
+	Path.clear();
+	m_SettledCount = 0;
+
+	if( From >= m_NodeCount || To >= m_NodeCount )
+	{
+		return FLT_MAX;
+	}
+
+	m_Generation ++;
+
+	if( m_Generation == 0 )
+	{
+		// the stamps have wrapped round, this happens once every 2^32 queries
+		fill( m_Forward.m_Stamp.begin(), m_Forward.m_Stamp.end(), 0u );
+		fill( m_Backward.m_Stamp.begin(), m_Backward.m_Stamp.end(), 0u );
+		m_Generation = 1;
+	}
+
+	m_Forward.m_Heap.clear();
+	m_Backward.m_Heap.clear();
+
+	Reach( m_Forward, From, 0.0f, NO_NODE, NO_NODE );
+	Reach( m_Backward, To, 0.0f, NO_NODE, NO_NODE );
+
+	float best = FLT_MAX;
+	unsigned int meet = NO_NODE;
+
+	while( !m_Forward.m_Heap.empty() || !m_Backward.m_Heap.empty() )
+	{
+		// step whichever search has the closer node next. The forward search climbs the upward edges, the backward
+		// search climbs the downward edges against their direction.
+		bool forward = m_Backward.m_Heap.empty() ||
+			( !m_Forward.m_Heap.empty() && m_Forward.m_Heap.front().first <= m_Backward.m_Heap.front().first );
+
+		Direction &search = forward ? m_Forward : m_Backward;
+		Direction &other = forward ? m_Backward : m_Forward;
+		const vector< unsigned int > &offsets = forward ? m_UpOffsets : m_DownOffsets;
+		const vector< Edge > &edges = forward ? m_UpEdges : m_DownEdges;
+		const vector< unsigned int > &stallOffsets = forward ? m_DownOffsets : m_UpOffsets;
+		const vector< Edge > &stallEdges = forward ? m_DownEdges : m_UpEdges;
+
+		pop_heap( search.m_Heap.begin(), search.m_Heap.end(), compare );
+		HeapEntry top = search.m_Heap.back();
+		search.m_Heap.pop_back();
+
+		unsigned int node = top.second;
+
+		if( top.first > search.m_Distance[node] )
+		{
+			continue; // stale entry
+		}
+
+		if( top.first >= best )
+		{
+			search.m_Heap.clear(); // nothing this search has left can improve on the best path
+			continue;
+		}
+
+		m_SettledCount ++;
+
+		if( Reached( other, node ) && top.first + other.m_Distance[node] < best )
+		{
+			best = top.first + other.m_Distance[node];
+			meet = node;
+		}
+
+		// stall on demand, if a higher ranked node this search has reached has an edge down to this one that is
+		// cheaper than the path the search found, no shortest path climbs through here
+		bool stalled = false;
+
+		for( unsigned int e = stallOffsets[node]; e < stallOffsets[node + 1]; e ++ )
+		{
+			unsigned int higher = stallEdges[e].node;
+
+			if( Reached( search, higher ) && search.m_Distance[higher] + stallEdges[e].weight < top.first )
+			{
+				stalled = true;
+				break;
+			}
+		}
+
+		if( stalled )
+		{
+			continue;
+		}
+
+		for( unsigned int e = offsets[node]; e < offsets[node + 1]; e ++ )
+		{
+			unsigned int next = edges[e].node;
+			float d = top.first + edges[e].weight;
+
+			if( !Reached( search, next ) || d < search.m_Distance[next] )
+			{
+				Reach( search, next, d, node, e );
+			}
+		}
+	}
+
+	if( meet == NO_NODE )
+	{
+		return FLT_MAX;
+	}
+
+	// the forward half, collected from the meeting node back to the start then unpacked in order
+	m_Unpack.clear();
+
+	for( unsigned int n = meet; m_Forward.m_Parent[n] != NO_NODE; n = m_Forward.m_Parent[n] )
+	{
+		Shortcut step;
+		step.from = m_Forward.m_Parent[n];
+		step.edge = m_UpEdges[ m_Forward.m_ParentEdge[n] ];
+		m_Unpack.push_back( step );
+	}
+
+	// Unpack stacks its work above these, so the collected edges stay where they are
+	Path.push_back( From );
+
+	for( size_t i = m_Unpack.size(); i -- > 0; )
+	{
+		Shortcut step = m_Unpack[i];
+		Unpack( step.from, step.edge.node, step.edge.middle, Path );
+	}
+
+	// the backward half runs from the meeting node down to the goal already in order
+	for( unsigned int n = meet; m_Backward.m_Parent[n] != NO_NODE; n = m_Backward.m_Parent[n] )
+	{
+		Unpack( n, m_Backward.m_Parent[n], m_DownEdges[ m_Backward.m_ParentEdge[n] ].middle, Path );
+	}
+
+	return best;
+}
+
+// The middle of the edge between Node and At, looked up in At's edges
+inline unsigned int ContractionHierarchy::FindMiddle( const vector< unsigned int > &Offsets, const vector< Edge > &Edges, unsigned int At, unsigned int Node ) const
+{
+	for( unsigned int e = Offsets[At]; e < Offsets[At + 1]; e ++ )
+	{
+		if( Edges[e].node == Node )
+		{
+			return Edges[e].middle;
+		}
+	}
+
+	return NO_NODE;
+}
+
+// Appends the nodes after From on the edge From -> To, expanding shortcuts into the two edges each one replaced. The
+// middle node is ranked below both ends so those two edges are stored at the middle node.
+void ContractionHierarchy::Unpack( unsigned int From, unsigned int To, unsigned int Middle, vector< unsigned int > &Path )
+{
+	size_t base = m_Unpack.size();
+
+	Shortcut edge;
+	edge.from = From;
+	edge.edge.node = To;
+	edge.edge.middle = Middle;
+	m_Unpack.push_back( edge );
+
+	while( m_Unpack.size() > base )
+	{
+		Shortcut top = m_Unpack.back();
+		m_Unpack.pop_back();
+
+		unsigned int middle = top.edge.middle;
+
+		if( middle == NO_NODE )
+		{
+			Path.push_back( top.edge.node );
+			continue;
+		}
+
+		// second half first so the first half comes off the stack first
+		Shortcut second;
+		second.from = middle;
+		second.edge.node = top.edge.node;
+		second.edge.middle = FindMiddle( m_UpOffsets, m_UpEdges, middle, top.edge.node );
+		m_Unpack.push_back( second );
+
+		Shortcut first;
+		first.from = top.from;
+		first.edge.node = middle;
+		first.edge.middle = FindMiddle( m_DownOffsets, m_DownEdges, middle, top.from );
+		m_Unpack.push_back( first );
+	}
+}
+
+// Hierarchy file, laid out the same way as a graph file
+//
+//   header | up offsets uint32[V + 1] | up edges Edge[up count] | down offsets uint32[V + 1] | down edges Edge[down count]
+
+enum
+{
+	HIERARCHY_FILE_VERSION = 1,
+};
+
+class HierarchyFileHeader
+{
+public:
+
+	char magic[8]; // "ASTARCHF"
+	uint32_t version;
+	uint32_t byteOrder;
+	uint32_t nodeCount;
+	uint32_t upEdgeCount;
+	uint32_t downEdgeCount;
+	uint32_t reserved;
+
+	uint64_t upOffsetsAt;
+	uint64_t upEdgesAt;
+	uint64_t downOffsetsAt;
+	uint64_t downEdgesAt;
+	uint64_t fileSize;
+};
+
+static const char HierarchyFileMagic[8] = { 'A', 'S', 'T', 'A', 'R', 'C', 'H', 'F' };
+
+bool ContractionHierarchy::Save( const char *Path ) const
+{
+	uint64_t V = m_NodeCount;
+
+	if( m_UpOffsets.size() != V + 1 )
+	{
+		return false; // nothing built or loaded
+	}
+
+	HierarchyFileHeader header;
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.magic, HierarchyFileMagic, sizeof( header.magic ) );
+	header.version = HIERARCHY_FILE_VERSION;
+	header.byteOrder = GRAPH_FILE_BYTE_ORDER;
+	header.nodeCount = m_NodeCount;
+	header.upEdgeCount = (uint32_t)m_UpEdges.size();
+	header.downEdgeCount = (uint32_t)m_DownEdges.size();
+
+	uint64_t end = sizeof( header );
+
+	header.upOffsetsAt = GraphFileSection( end, (V + 1) * sizeof( uint32_t ) );
+	header.upEdgesAt = GraphFileSection( end, m_UpEdges.size() * sizeof( Edge ) );
+	header.downOffsetsAt = GraphFileSection( end, (V + 1) * sizeof( uint32_t ) );
+	header.downEdgesAt = GraphFileSection( end, m_DownEdges.size() * sizeof( Edge ) );
+	header.fileSize = end;
+
+	ofstream file( Path, ios::out | ios::binary | ios::trunc );
+
+	if( !file )
+	{
+		return false;
+	}
+
+	GraphFileWriteAt( file, 0, &header, sizeof( header ) );
+	GraphFileWriteAt( file, header.upOffsetsAt, &m_UpOffsets[0], (V + 1) * sizeof( uint32_t ) );
+	GraphFileWriteAt( file, header.upEdgesAt, m_UpEdges.empty() ? NULL : &m_UpEdges[0], m_UpEdges.size() * sizeof( Edge ) );
+	GraphFileWriteAt( file, header.downOffsetsAt, &m_DownOffsets[0], (V + 1) * sizeof( uint32_t ) );
+	GraphFileWriteAt( file, header.downEdgesAt, m_DownEdges.empty() ? NULL : &m_DownEdges[0], m_DownEdges.size() * sizeof( Edge ) );
+
+	// pad to the size in the header
+	file.seekp( 0, ios::end );
+
+	if( (uint64_t)file.tellp() < end )
+	{
+		file.seekp( (streamoff)end - 1 );
+		file.put( 0 );
+	}
+
+	return (bool)file;
+}
+
+// Reads Count elements at At into Array if they lie inside a file of Size bytes
+template <class T> static bool HierarchyFileRead( ifstream &File, uint64_t Size, uint64_t At, uint64_t Count, vector< T > &Array )
+{
+	if( (At % 8) != 0 || At < sizeof( HierarchyFileHeader ) || At > Size || Count * sizeof( T ) > Size - At )
+	{
+		return false;
+	}
+
+	Array.resize( (size_t)Count );
+
+	if( Count )
+	{
+		File.seekg( (streamoff)At );
+		File.read( reinterpret_cast< char * >( &Array[0] ), (streamsize)( Count * sizeof( T ) ) );
+	}
+
+	return (bool)File;
+}
+
+bool ContractionHierarchy::Load( const char *Path )
+{
+	ifstream file( Path, ios::in | ios::binary );
+
+	if( !file )
+	{
+		return false;
+	}
+
+	file.seekg( 0, ios::end );
+	uint64_t size = (uint64_t)file.tellg();
+	file.seekg( 0 );
+
+	HierarchyFileHeader header;
+
+	if( size < sizeof( header ) || !file.read( reinterpret_cast< char * >( &header ), sizeof( header ) ) )
+	{
+		return false;
+	}
+
+	if( memcmp( header.magic, HierarchyFileMagic, sizeof( header.magic ) ) != 0 ||
+		header.version != HIERARCHY_FILE_VERSION ||
+		header.byteOrder != GRAPH_FILE_BYTE_ORDER ||
+		header.fileSize > size )
+	{
+		return false;
+	}
+
+	uint64_t V = header.nodeCount;
+
+	if( !HierarchyFileRead( file, size, header.upOffsetsAt, V + 1, m_UpOffsets ) ||
+		!HierarchyFileRead( file, size, header.upEdgesAt, header.upEdgeCount, m_UpEdges ) ||
+		!HierarchyFileRead( file, size, header.downOffsetsAt, V + 1, m_DownOffsets ) ||
+		!HierarchyFileRead( file, size, header.downEdgesAt, header.downEdgeCount, m_DownEdges ) ||
+		m_UpOffsets[V] != header.upEdgeCount || m_DownOffsets[V] != header.downEdgeCount )
+	{
+		m_NodeCount = 0;
+		m_UpOffsets.clear();
+		m_DownOffsets.clear();
+		return false;
+	}
+
+	// unlike a graph file the hierarchy is read into memory, so its edges are checked once here rather than trusted
+	m_ShortcutCount = 0;
+
+	for( int direction = 0; direction < 2; direction ++ )
+	{
+		const vector< unsigned int > &offsets = direction ? m_DownOffsets : m_UpOffsets;
+		const vector< Edge > &edges = direction ? m_DownEdges : m_UpEdges;
+
+		for( uint64_t n = 0; n < V; n ++ )
+		{
+			if( offsets[n] > offsets[n + 1] )
+			{
+				m_NodeCount = 0;
+				return false;
+			}
+		}
+
+		for( size_t e = 0; e < edges.size(); e ++ )
+		{
+			if( edges[e].node >= V || ( edges[e].middle != NO_NODE && edges[e].middle >= V ) )
+			{
+				m_NodeCount = 0;
+				return false;
+			}
+
+			m_ShortcutCount += edges[e].middle != NO_NODE;
+		}
+	}
+
+	Reset( header.nodeCount );
+	return true;
+}
+
+// Contraction Hierarchy Ends -------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Batch Search Code Starts ---------------------------------------------------------------------------------------------------------------------
+
+// Runs many independent start/goal queries across a pool of worker threads. Each worker owns its own search object,
+// and so its own node pool, for as long as the batch search exists, so warm workers don't allocate nodes. The states
+// and whatever they point at (a CSRGraph say) are shared by every worker and must only be read during a search.
+// SearchType is an AStarSearch instantiation that does no tracing.
+
+template <class SearchType> class AStarBatchSearch
+{
+public:
+
+	typedef typename SearchType::UserStateType UserState;
+	typedef typename SearchType::SearchResult SearchResult;
+	typedef typename SearchType::Clock Clock;
+
+	class Query
+	{
+		public:
+
+			UserState start;
+			UserState goal;
+			Query() {}
+			Query( const UserState &Start, const UserState &Goal ) : start( Start ), goal( Goal ) {}
+	};
+
+	// Threads is the number of workers, 0 for one per hardware thread. MaxNodesPerSearch caps each worker's node pool.
+	AStarBatchSearch( unsigned int Threads = 0, unsigned int MaxNodesPerSearch = 0 ) :
+		m_MaxNodesPerSearch( MaxNodesPerSearch ),
+		m_Batch( 0 ),
+		m_Busy( 0 ),
+		m_Exit( false ),
+		m_Queries( NULL ),
+		m_Results( NULL ),
+		m_MaxSteps( 0 ),
+		m_TimeLimit( Clock::duration::zero() ),
+		m_Next( 0 )
+	{
+		if( Threads == 0 )
+		{
+			Threads = thread::hardware_concurrency();
+		}
+
+		if( Threads == 0 )
+		{
+			Threads = 1;
+		}
+
+		for( unsigned int i = 0; i < Threads; i ++ )
+		{
+			m_Workers.push_back( thread( &AStarBatchSearch::Worker, this ) );
+		}
+	}
+
+	~AStarBatchSearch()
+	{
+		{
+			unique_lock< mutex > lock( m_Mutex );
+			m_Exit = true;
+		}
+
+		m_WorkReady.notify_all();
+
+		for( size_t i = 0; i < m_Workers.size(); i ++ )
+		{
+			m_Workers[i].join();
+		}
+	}
+
+	// Runs every query and blocks until all are done. Results[i] is the outcome of Queries[i]. Each query may take at
+	// most MaxSteps search steps and TimeLimit of wall clock time (0 for no limit), a query that runs out is cancelled
+	// and its result left in SEARCH_STATE_SEARCHING.
+	void Run( const vector< Query > &Queries, vector< SearchResult > &Results, unsigned int MaxSteps = 0, typename Clock::duration TimeLimit = Clock::duration::zero() )
+	{
+		unique_lock< mutex > runLock( m_RunMutex ); // one batch at a time
+
+		Results.resize( Queries.size() );
+
+		if( Queries.empty() )
+		{
+			return;
+		}
+
+		unique_lock< mutex > lock( m_Mutex );
+
+		m_Queries = &Queries;
+		m_Results = &Results;
+		m_MaxSteps = MaxSteps;
+		m_TimeLimit = TimeLimit;
+		m_Next = 0;
+		m_Busy = (unsigned int)m_Workers.size();
+		m_Batch ++;
+
+		m_WorkReady.notify_all();
+
+		while( m_Busy )
+		{
+			m_WorkDone.wait( lock );
+		}
+
+		m_Queries = NULL;
+		m_Results = NULL;
+	}
+
+	unsigned int GetThreadCount() const { return (unsigned int)m_Workers.size(); }
+
+private:
+
+	void Worker()
+	{
+		SearchType astarsearch( m_MaxNodesPerSearch ); // lives as long as the worker, so its node pool stays warm
+		unsigned long long batch = 0;
+
+		for( ;; )
+		{
+			{
+				unique_lock< mutex > lock( m_Mutex );
+
+				while( !m_Exit && m_Batch == batch )
+				{
+					m_WorkReady.wait( lock );
+				}
+
+				if( m_Exit )
+				{
+					return;
+				}
+
+				batch = m_Batch;
+			}
+
+			const vector< Query > &queries = *m_Queries;
+			vector< SearchResult > &results = *m_Results;
+
+			for( size_t i = m_Next ++; i < queries.size(); i = m_Next ++ )
+			{
+				UserState start = queries[i].start;
+				UserState goal = queries[i].goal;
+				typename Clock::time_point deadline = Clock::time_point::max();
+
+				if( m_TimeLimit != Clock::duration::zero() )
+				{
+					deadline = Clock::now() + m_TimeLimit;
+				}
+
+				astarsearch.SetStartAndGoalStates( start, goal );
+
+				unsigned int state = astarsearch.Search( results[i], m_MaxSteps, deadline );
+
+				if( state == SearchType::SEARCH_STATE_SUCCEEDED )
+				{
+					astarsearch.FreeSolutionNodes();
+				}
+				else if( state == SearchType::SEARCH_STATE_SEARCHING )
+				{
+					astarsearch.CancelSearch();
+				}
+			}
+
+			{
+				unique_lock< mutex > lock( m_Mutex );
+
+				if( -- m_Busy == 0 )
+				{
+					m_WorkDone.notify_one();
+				}
+			}
+		}
+	}
+
+	// the workers hold a pointer to the batch search, so it can't be copied
+	AStarBatchSearch( const AStarBatchSearch & );
+	AStarBatchSearch &operator=( const AStarBatchSearch & );
+
+	vector< thread > m_Workers;
+	unsigned int m_MaxNodesPerSearch;
+
+	mutex m_RunMutex;
+	mutex m_Mutex;
+	condition_variable m_WorkReady;
+	condition_variable m_WorkDone;
+	unsigned long long m_Batch; // bumped to hand the workers a new batch
+	unsigned int m_Busy; // workers still working on the current batch
+	bool m_Exit;
+
+	// the current batch
+	const vector< Query > *m_Queries;
+	vector< SearchResult > *m_Results;
+	unsigned int m_MaxSteps;
+	typename Clock::duration m_TimeLimit;
+	atomic< size_t > m_Next; // next query to hand out
+};
+
+// Batch Search Ends ----------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Parallel A* Code Starts ----------------------------------------------------------------------------------------------------------------------
+
+// Hash distributed A* (HDA*, Kishimoto, Fukunaga and Botea), one search spread over several threads. Every state
+// belongs to one thread, picked by its hash, and each thread keeps the open list, closed list and index for its own
+// states. A thread expands its best open node and sends each successor to the thread that owns it. Messages travel
+// through one lock free queue per thread that any thread can push a batch onto and the owner takes in one go.
+//
+// The threads don't expand in exact f order between them, so a goal found first is not necessarily the best. The
+// cheapest goal so far is kept as the incumbent, nodes that can't beat it are not expanded, and the search ends once
+// no thread has a node that could beat it and no message is on its way. That is tracked by one counter, of threads
+// that are working plus messages sent and not yet taken in, which only reaches 0 when the search is over. The
+// solution then costs the same as AStarSearch's, for an admissible heuristic.
+//
+// The UserState contract is AStarSearch's plus Hash(), as for AStarHashIndex. GetSuccessors is called on many threads
+// at once, so it must only read shared data.
+
+template <class UserState, template <class, class> class OpenList = AStarBinaryHeap> class AStarHDASearch
 {
 
-public: // data
+public: // data
+
+	enum
+	{
+		SEARCH_STATE_NOT_INITIALISED,
+		SEARCH_STATE_SEARCHING,
+		SEARCH_STATE_SUCCEEDED,
+		SEARCH_STATE_FAILED,
+		SEARCH_STATE_OUT_OF_MEMORY,
+	};
+
+	class Node
+	{
+		public:
+			Node *parent; // may belong to another thread
+			float g;
+			float h;
+			float f;
+			bool m_Open;
+			unsigned int m_ListIndex; // position in the owner's open heap
+			Node() :
+				parent( 0 ),
+				g( 0.0f ),
+				h( 0.0f ),
+				f( 0.0f ),
+				m_Open( false ),
+				m_ListIndex( 0 )
+			{}
+			UserState m_UserState;
+	};
+
+	class HeapCompare_f
+	{
+		public:
+
+			bool operator() ( const Node *x, const Node *y ) const
+			{
+				return x->f > y->f;
+			}
+	};
+
+	class SearchResult // Outcome of Search()
+	{
+		public:
+
+			unsigned int state;
+			vector< UserState > path;
+			float cost;
+			unsigned int steps; // the same as nodesExpanded, all threads together
+			unsigned int nodesExpanded;
+			SearchResult() :
+				state( SEARCH_STATE_NOT_INITIALISED ),
+				cost( FLT_MAX ),
+				steps( 0 ),
+				nodesExpanded( 0 )
+			{}
+	};
+
+	typedef std::chrono::steady_clock Clock;
+
+	typedef UserState UserStateType;
+
+
+public: // methods
+
+
+	// Threads is the number of threads, 0 for one per hardware thread. MaxNodesPerThread caps each thread's node pool.
+	AStarHDASearch( unsigned int Threads = 0, unsigned int MaxNodesPerThread = 0 ) :
+		m_State( SEARCH_STATE_NOT_INITIALISED ),
+		m_Active( 0 ),
+		m_Done( false ),
+		m_Stop( false ),
+		m_OutOfMemory( false ),
+		m_BestCost( FLT_MAX ),
+		m_BestGoal( NULL ),
+		m_NodesExpanded( 0 ),
+		m_SolutionCost( FLT_MAX ),
+		m_CurrentSolutionNode( 0 )
+	{
+		if( Threads == 0 )
+		{
+			Threads = thread::hardware_concurrency();
+		}
+
+		if( Threads == 0 )
+		{
+			Threads = 1;
+		}
+
+		for( unsigned int i = 0; i < Threads; i ++ )
+		{
+			m_Workers.push_back( new Worker( this, i, MaxNodesPerThread ) );
+		}
+	}
+
+	~AStarHDASearch()
+	{
+		FreeAllNodes();
+
+		for( size_t i = 0; i < m_Workers.size(); i ++ )
+		{
+			delete m_Workers[i];
+		}
+	}
+
+	// Set Start and goal states
+	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	{
+		FreeAllNodes();
+		FreeSolutionNodes();
+
+		m_GoalState = Goal;
+		m_BestCost = FLT_MAX;
+		m_BestGoal = NULL;
+		m_Done = false;
+		m_OutOfMemory = false;
+		m_NodesExpanded = 0;
+		m_State = SEARCH_STATE_SEARCHING;
+
+		// the start goes to its owner like any other state, the thread that takes it in starts the search
+		Message *message = new Message;
+		message->entries.push_back( Entry( Start, 0.0f, NULL ) );
+		Send( Owner( Start ), message );
+	}
+
+	// Runs the threads until the search ends or the Deadline passes. A search that runs out of time is left
+	// SEARCHING with everything the threads had, and carries on from there when Search is called again.
+	unsigned int Search( SearchResult &Result, Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			m_Stop = false;
+			m_Active += (unsigned int)m_Workers.size(); // every thread starts out working
+
+			vector< thread > threads;
+
+			for( size_t i = 1; i < m_Workers.size(); i ++ )
+			{
+				threads.push_back( thread( &Worker::Run, m_Workers[i], Deadline ) );
+			}
+
+			m_Workers[0]->Run( Deadline ); // the calling thread is one of them
+
+			for( size_t i = 0; i < threads.size(); i ++ )
+			{
+				threads[i].join();
+			}
+
+			m_NodesExpanded = 0;
+
+			for( size_t i = 0; i < m_Workers.size(); i ++ )
+			{
+				m_NodesExpanded += m_Workers[i]->m_NodesExpanded;
+			}
+
+			if( m_OutOfMemory )
+			{
+				FreeAllNodes();
+				m_State = SEARCH_STATE_OUT_OF_MEMORY;
+			}
+			else if( m_Done )
+			{
+				LinkSolution();
+				m_State = m_BestGoal ? SEARCH_STATE_SUCCEEDED : SEARCH_STATE_FAILED;
+				FreeAllNodes();
+			}
+		}
+
+		Result.state = m_State;
+		Result.steps = m_NodesExpanded;
+		Result.nodesExpanded = m_NodesExpanded;
+		Result.cost = GetSolutionCost();
+		Result.path = m_Solution;
+
+		return m_State;
+	}
+
+	SearchResult Search( Clock::time_point Deadline = Clock::time_point::max() )
+	{
+		SearchResult result;
+		Search( result, Deadline );
+		return result;
+	}
+
+	// Abandons a search that is still running and frees all of its nodes
+	void CancelSearch()
+	{
+		if( m_State == SEARCH_STATE_SEARCHING )
+		{
+			FreeAllNodes();
+			m_State = SEARCH_STATE_FAILED;
+		}
+	}
+
+	// The nodes are freed as soon as the search ends, the solution is kept until this is called
+	void FreeSolutionNodes()
+	{
+		m_Solution.clear();
+		m_CurrentSolutionNode = 0;
+	}
+
+	// Functions for traversing the solution, as for AStarSearch
+
+	UserState *GetSolutionStart()
+	{
+		m_CurrentSolutionNode = 0;
+		return m_Solution.empty() ? NULL : &m_Solution[0];
+	}
+
+	UserState *GetSolutionNext()
+	{
+		if( m_CurrentSolutionNode + 1 < m_Solution.size() )
+		{
+			m_CurrentSolutionNode ++;
+			return &m_Solution[ m_CurrentSolutionNode ];
+		}
+
+		return NULL;
+	}
+
+	UserState *GetSolutionEnd()
+	{
+		m_CurrentSolutionNode = m_Solution.empty() ? 0 : m_Solution.size() - 1;
+		return m_Solution.empty() ? NULL : &m_Solution.back();
+	}
+
+	UserState *GetSolutionPrev()
+	{
+		if( m_CurrentSolutionNode > 0 && m_CurrentSolutionNode < m_Solution.size() )
+		{
+			m_CurrentSolutionNode --;
+			return &m_Solution[ m_CurrentSolutionNode ];
+		}
+
+		return NULL;
+	}
+
+	// Get final cost of solution, FLT_MAX if there is none
+	float GetSolutionCost()
+	{
+		return m_State == SEARCH_STATE_SUCCEEDED ? m_SolutionCost : FLT_MAX;
+	}
+
+	unsigned int GetNodesExpanded() { return m_NodesExpanded; }
+	unsigned int GetThreadCount() { return (unsigned int)m_Workers.size(); }
+
+private: // data
+
+	class Entry // A state sent to its owner, reached at cost g through parent
+	{
+		public:
+
+			UserState state;
+			float g;
+			Node *parent;
+			Entry( const UserState &State, float G, Node *Parent ) : state( State ), g( G ), parent( Parent ) {}
+	};
+
+	class Message // A batch of states for one thread, linked into its queue
+	{
+		public:
+
+			Message *next;
+			vector< Entry > entries;
+	};
+
+	// One thread's share of the search. It is what GetSuccessors is handed, so successors go to the thread expanding.
+	class Worker
+	{
+		public:
+
+			typedef UserState UserStateType;
+
+			Worker( AStarHDASearch *Search, unsigned int Id, unsigned int MaxNodes ) :
+				m_Search( Search ),
+				m_Id( Id ),
+				m_Inbox( NULL ),
+				m_NodePool( MaxNodes ),
+				m_NodesExpanded( 0 )
+			{
+			}
+
+			// User calls this to add a successor to a list of successors when expanding the search frontier
+			bool AddSuccessor( UserState &State )
+			{
+				m_Successors.push_back( State );
+				return true;
+			}
+
+			void Run( Clock::time_point Deadline )
+			{
+				const unsigned int StepsPerClockCheck = 64;
+
+				bool timed = Deadline != Clock::time_point::max();
+				bool working = true;
+				unsigned int steps = 0;
+
+				m_Outbox.resize( m_Search->m_Workers.size() );
+
+				while( !m_Search->m_Done && !m_Search->m_Stop )
+				{
+					// not checked straight away, starting the threads can take longer than a short deadline
+					if( timed && (++ steps % StepsPerClockCheck) == 0 && Clock::now() >= Deadline )
+					{
+						m_Search->m_Stop = true;
+						break;
+					}
+
+					Message *messages = m_Inbox.exchange( NULL, memory_order_acquire );
+
+					if( messages && !working )
+					{
+						working = true;
+						m_Search->m_Active ++;
+					}
+
+					while( messages )
+					{
+						Message *message = messages;
+						messages = messages->next;
+
+						for( size_t i = 0; i < message->entries.size(); i ++ )
+						{
+							Entry &entry = message->entries[i];
+							TakeIn( entry.state, entry.g, entry.parent );
+						}
+
+						m_Search->m_Active -= (unsigned int)message->entries.size();
+						delete message;
+					}
+
+					if( !m_OpenList.Empty() && m_OpenList.Top()->f < m_Search->m_BestCost.load( memory_order_relaxed ) )
+					{
+						Expand();
+						continue;
+					}
+
+					// nothing here can beat the incumbent, wait for messages or for the others to finish
+					if( working )
+					{
+						working = false;
+
+						if( -- m_Search->m_Active == 0 )
+						{
+							m_Search->m_Done = true;
+						}
+					}
+					else
+					{
+						this_thread::yield();
+					}
+				}
+
+				if( working )
+				{
+					m_Search->m_Active --; // made up again when the search is resumed
+				}
+			}
+
+			void Expand()
+			{
+				Node *n = m_OpenList.Pop();
+				n->m_Open = false;
+
+				m_Successors.clear();
+
+				if( !n->m_UserState.GetSuccessors( this, n->parent ? &n->parent->m_UserState : NULL ) )
+				{
+					m_Search->m_OutOfMemory = true;
+					m_Search->m_Done = true;
+					return;
+				}
+
+				m_NodesExpanded ++;
+
+				for( size_t i = 0; i < m_Successors.size(); i ++ )
+				{
+					float g = n->g + n->m_UserState.GetCost( m_Successors[i] );
+					unsigned int owner = m_Search->Owner( m_Successors[i] );
+
+					if( owner == m_Id )
+					{
+						TakeIn( m_Successors[i], g, n );
+						continue;
+					}
+
+					if( !m_Outbox[owner] )
+					{
+						m_Outbox[owner] = new Message;
+					}
+
+					m_Outbox[owner]->entries.push_back( Entry( m_Successors[i], g, n ) );
+				}
+
+				for( size_t i = 0; i < m_Outbox.size(); i ++ )
+				{
+					if( m_Outbox[i] )
+					{
+						m_Search->Send( (unsigned int)i, m_Outbox[i] );
+						m_Outbox[i] = NULL;
+					}
+				}
+			}
+
+			// A state this thread owns has been reached at cost g, keep it if it is the cheapest way there so far
+			void TakeIn( UserState &State, float g, Node *Parent )
+			{
+				Node *node = m_Index.Find( State );
 
-	enum
-	{
-		SEARCH_STATE_NOT_INITIALISED,
-		SEARCH_STATE_SEARCHING,
-		SEARCH_STATE_SUCCEEDED,
-		SEARCH_STATE_FAILED,
-	};
+				if( node && node->g <= g )
+				{
+					return;
+				}
 
-	public:
+				if( !node )
+				{
+					node = m_NodePool.Allocate();
 
-	class Node // A node represents a possible state in the search.
-    {
-        public:
-            Node *parent; // used during the search to record the parent of successor nodes
-			Node *child; // used after the search for the application to view the search in reverse
-			float g; // cost of this node + it's predecessors
-			float h; // heuristic estimate of distance to goal
-			float f; // sum of cumulative cost of predecessors and self and heuristic
-			Node() :
-				parent( 0 ),
-				child( 0 ),
-				g( 0.0f ),
-				h( 0.0f ),
-				f( 0.0f )
-			{}
-            UserState m_UserState;
-	};
+					if( !node )
+					{
+						m_Search->m_OutOfMemory = true;
+						m_Search->m_Done = true;
+						return;
+					}
 
-    class HeapCompare_f // For sorting the heap the STL needs compare function that lets us compare the f value of two nodes
-	{
-		public:
+					node->m_UserState = State;
+					node->h = node->m_UserState.GoalDistanceEstimate( m_Search->m_GoalState );
+					m_Index.Insert( node );
+					m_Nodes.push_back( node );
+				}
 
-			bool operator() ( const Node *x, const Node *y ) const
+				node->g = g;
+				node->f = g + node->h;
+				node->parent = Parent;
+
+				if( node->m_UserState.IsGoal( m_Search->m_GoalState ) )
+				{
+					// a goal is not expanded, it only lowers the incumbent
+					m_Search->Improve( node );
+				}
+				else if( node->m_Open )
+				{
+					m_OpenList.Update( node );
+				}
+				else
+				{
+					m_OpenList.Push( node ); // new, or closed and reached more cheaply
+					node->m_Open = true;
+				}
+			}
+
+			void FreeAllNodes()
 			{
-				return x->f > y->f;
+				for( Message *message = m_Inbox.exchange( NULL ); message; )
+				{
+					Message *next = message->next;
+					delete message;
+					message = next;
+				}
+
+				for( size_t i = 0; i < m_Nodes.size(); i ++ )
+				{
+					m_NodePool.Free( m_Nodes[i] );
+				}
+
+				m_Nodes.clear();
+				m_Index.Clear();
+				m_OpenList.Clear();
 			}
+
+			AStarHDASearch *m_Search;
+			unsigned int m_Id;
+
+			// Batches pushed by any thread, newest first, taken all at once by this one
+			atomic< Message * > m_Inbox;
+
+			OpenList< Node, HeapCompare_f > m_OpenList;
+			AStarHashIndex< Node > m_Index;
+			AStarNodePool< Node > m_NodePool;
+			vector< Node * > m_Nodes; // every node in use, to free them
+			vector< UserState > m_Successors;
+			vector< Message * > m_Outbox; // the batch being put together for each thread
+			unsigned int m_NodesExpanded;
+
+		private:
+
+			// the node pool can't be copied
+			Worker( const Worker & );
+			Worker &operator=( const Worker & );
 	};
 
+	vector< Worker * > m_Workers;
 
-public: // methods
+	unsigned int m_State;
+	UserState m_GoalState;
 
+	// threads working plus states sent and not yet taken in, the search is over when it reaches 0
+	atomic< unsigned int > m_Active;
+	atomic< bool > m_Done;
+	atomic< bool > m_Stop;
+	atomic< bool > m_OutOfMemory;
 
-	// constructor just initializes private data
-	AStarSearch() :
-		m_State( SEARCH_STATE_NOT_INITIALISED ),
-		m_CurrentSolutionNode( NULL ),
-		m_AllocateNodeCount(0)
+	// The incumbent, the cheapest goal found so far
+	mutex m_BestMutex;
+	atomic< float > m_BestCost;
+	Node *m_BestGoal;
+
+	unsigned int m_NodesExpanded;
+
+	vector< UserState > m_Solution;
+	float m_SolutionCost;
+	size_t m_CurrentSolutionNode;
+
+private: // methods
+
+	unsigned int Owner( UserState &State )
 	{
+		// a different mix from AStarHashIndex's, so each thread's states still spread over its own index
+		unsigned long long mixed = (unsigned long long)State.Hash() * 0xFF51AFD7ED558CCDULL;
+		return (unsigned int)( ( mixed >> 32 ) % m_Workers.size() );
 	}
 
-	// Set Start and goal states
-	void SetStartAndGoalStates( UserState &Start, UserState &Goal )
+	void Send( unsigned int To, Message *message )
 	{
+		m_Active += (unsigned int)message->entries.size(); // counted before it can be taken in
 
+		atomic< Message * > &inbox = m_Workers[To]->m_Inbox;
+		message->next = inbox.load( memory_order_relaxed );
 
-		m_Start = AllocateNode();
-		m_Goal = AllocateNode();
-		m_Start->m_UserState = Start;
-		m_Goal->m_UserState = Goal;
+		while( !inbox.compare_exchange_weak( message->next, message, memory_order_release, memory_order_relaxed ) )
+		{
+		}
+	}
 
-		m_State = SEARCH_STATE_SEARCHING;
+	void Improve( Node *Goal )
+	{
+		lock_guard< mutex > lock( m_BestMutex );
 
-		// Initialize the AStar specific parts of the Start Node. The user only needs fill out the state information.
+		if( Goal->g < m_BestCost )
+		{
+			m_BestCost = Goal->g;
+			m_BestGoal = Goal;
+		}
+	}
 
-		m_Start->g = 0;
-		m_Start->h = m_Start->m_UserState.GoalDistanceEstimate( m_Goal->m_UserState );
-		m_Start->f = m_Start->g + m_Start->h;
-		m_Start->parent = 0;
+	void LinkSolution()
+	{
+		m_Solution.clear();
+		m_CurrentSolutionNode = 0;
 
-		// Push the start node on the Open list
-        m_OpenList.push_back( m_Start ); // heap now unsorted
+		if( !m_BestGoal )
+		{
+			return;
+		}
 
-		// Sort back element into heap
-		push_heap( m_OpenList.begin(), m_OpenList.end(), HeapCompare_f() );
+		// parents point across threads, which is safe now they have all stopped
+		for( Node *node = m_BestGoal; node; node = node->parent )
+		{
+			m_Solution.push_back( node->m_UserState );
+		}
 
-		// Initialize counter for search steps
-		m_Steps = 0;
+		reverse( m_Solution.begin(), m_Solution.end() );
+		m_SolutionCost = m_BestCost;
 	}
 
-	// Advances search one step
-	unsigned int SearchStep()
+	void FreeAllNodes()
 	{
+		for( size_t i = 0; i < m_Workers.size(); i ++ )
+		{
+			m_Workers[i]->FreeAllNodes();
+		}
+
+		m_Active = 0;
+		m_BestGoal = NULL;
+	}
 
-		// Next we want it to be safe to do a search step once the search has succeeded...
-		if( (m_State == SEARCH_STATE_SUCCEEDED) || (m_State == SEARCH_STATE_FAILED) )
+	// the workers hold a pointer to the search, so it can't be copied
+	AStarHDASearch( const AStarHDASearch & );
+	AStarHDASearch &operator=( const AStarHDASearch & );
+};
+
+// Parallel A* Ends -----------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Distance Matrix Code Starts ------------------------------------------------------------------------------------------------------------------
+
+// Costs of the shortest routes from each of a set of sources to each of a set of targets on a CSRGraph. Rather than
+// searching pair by pair, each source gets one Dijkstra search that runs until all of the targets are settled, so
+// the work around a source is done once for all of its targets. With fewer targets than sources the searches run
+// backwards from the targets instead, over the reverse adjacency from CSRGraph::BuildReverse, so there are only ever
+// as many searches as the shorter of the two lists.
+//
+// The searches are shared out between worker threads started for each Compute. Each worker has its own search arrays,
+// kept from one Compute to the next and stamped per search, so a search costs nothing to start however large the
+// graph is. The graph is only read.
+
+class CSRDistanceMatrix
+{
+public:
+
+	// Threads is the number of workers, 0 for one per hardware thread
+	CSRDistanceMatrix( unsigned int Threads = 0 ) :
+		m_Graph( NULL ),
+		m_Sources( NULL ),
+		m_Targets( NULL ),
+		m_Costs( NULL ),
+		m_Reverse( false ),
+		m_DistinctTargets( 0 ),
+		m_Next( 0 )
+	{
+		if( Threads == 0 )
 		{
-			return m_State;
+			Threads = thread::hardware_concurrency();
 		}
 
-		// Increment step count
-		m_Steps ++;
+		m_Workspaces.resize( Threads ? Threads : 1 );
+	}
 
-		// Pop the best node (the one with the lowest f)
-		Node *n = m_OpenList.front(); // get pointer to the node
-		pop_heap( m_OpenList.begin(), m_OpenList.end(), HeapCompare_f() );
-		m_OpenList.pop_back();
+	// Fills Costs with Sources.size() rows of Targets.size() costs, Costs[i * Targets.size() + j] being the cost from
+	// Sources[i] to Targets[j] and FLT_MAX where there is no route. A node may appear more than once in either list.
+	// Returns false, leaving Costs empty, if the searches would need to run backwards and the graph has no reverse
+	// adjacency.
+	bool Compute( const CSRGraph &Graph, const vector< unsigned int > &Sources, const vector< unsigned int > &Targets, vector< float > &Costs )
+	{
+		Costs.clear();
 
-		// Check for the goal, once we pop that we're done
-		if( n->m_UserState.IsGoal( m_Goal->m_UserState ) )
+		bool reverse = Targets.size() < Sources.size();
+
+		if( reverse && !Graph.HasReverse() )
 		{
-			// The user is going to use the Goal Node he passed in so copy the parent pointer of n
-			m_Goal->parent = n->parent;
-			m_Goal->g = n->g;
+			return false;
+		}
 
-			// A special case is that the goal was passed in as the start state so handle that here
-			if( false == n->m_UserState.IsSameState( m_Start->m_UserState ) )
-			{
-				FreeNode( n );
+		Costs.assign( Sources.size() * Targets.size(), FLT_MAX );
 
-				// set the child pointers in each node (except Goal which has no child)
-				Node *nodeChild = m_Goal;
-				Node *nodeParent = m_Goal->parent;
+		if( Costs.empty() )
+		{
+			return true;
+		}
 
-				do
-				{
-					nodeParent->child = nodeChild;
+		// each search starts from one of these, and stops once it has settled every node of the other list
+		const vector< unsigned int > &from = reverse ? Targets : Sources;
+		const vector< unsigned int > &to = reverse ? Sources : Targets;
 
-					nodeChild = nodeParent;
-					nodeParent = nodeParent->parent;
+		m_FirstSlot.resize( Graph.GetNodeCount(), NO_SLOT );
+		m_NextSlot.assign( to.size(), NO_SLOT );
+		m_DistinctTargets = 0;
 
-				}
-				while( nodeChild != m_Start ); // Start is always the first node by definition
+		for( size_t i = to.size(); i -- > 0; )
+		{
+			m_DistinctTargets += m_FirstSlot[ to[i] ] == NO_SLOT;
+			m_NextSlot[i] = m_FirstSlot[ to[i] ];
+			m_FirstSlot[ to[i] ] = (unsigned int)i;
+		}
 
-			}
+		m_Graph = &Graph;
+		m_Sources = &from;
+		m_Targets = &to;
+		m_Costs = &Costs;
+		m_Reverse = reverse;
+		m_Next = 0;
 
-			// delete nodes that are not needed for the solution
-			FreeUnusedNodes();
+		size_t threads = min( m_Workspaces.size(), from.size() );
+		vector< thread > workers;
 
-			m_State = SEARCH_STATE_SUCCEEDED;
+		for( size_t i = 1; i < threads; i ++ )
+		{
+			workers.push_back( thread( &CSRDistanceMatrix::Worker, this, &m_Workspaces[i] ) );
+		}
 
-			return m_State;
+		Worker( &m_Workspaces[0] ); // the calling thread does its share
+
+		for( size_t i = 0; i < workers.size(); i ++ )
+		{
+			workers[i].join();
 		}
-		else // not goal
+
+		for( size_t i = 0; i < to.size(); i ++ )
 		{
+			m_FirstSlot[ to[i] ] = NO_SLOT; // ready for the next Compute
+		}
 
-			// We now need to generate the successors of this node.
+		m_Graph = NULL;
+		m_Sources = m_Targets = NULL;
+		m_Costs = NULL;
 
-			m_Successors.clear(); // empty vector of successor nodes of n
+		return true;
+	}
 
-			bool ret = n->m_UserState.GetSuccessors( this, n->parent ? &n->parent->m_UserState : NULL );
+	unsigned int GetThreadCount() const { return (unsigned int)m_Workspaces.size(); }
 
-			n->m_UserState.PrintNodeInfo();
-			cout << " is selected for Expansion\n\n";
+	// Nodes settled by the searches of the last Compute, all added up
+	unsigned long long GetSettledCount() const
+	{
+		unsigned long long settled = 0;
 
-			// Now handle each successor to the current node ...
-			for( typename vector< Node * >::iterator successor = m_Successors.begin(); successor != m_Successors.end(); successor ++ )
+		for( size_t i = 0; i < m_Workspaces.size(); i ++ )
+		{
+			settled += m_Workspaces[i].settled;
+		}
+
+		return settled;
+	}
+
+private:
+
+	enum { NO_SLOT = 0xffffffff };
+
+	typedef pair< float, unsigned int > Entry;
+
+	class Workspace // One worker's search arrays, indexed by node and valid where stamp is the current generation
+	{
+		public:
+
+			vector< float > distance;
+			vector< unsigned int > stamp;
+			unsigned int generation;
+			vector< Entry > heap;
+			unsigned long long settled;
+
+			Workspace() :
+				generation( 0 ),
+				settled( 0 )
 			{
+			}
+	};
+
+	void Worker( Workspace *Space )
+	{
+		Space->settled = 0;
 
-				// 	The g value for this successor ...
-				float newg = n->g + n->m_UserState.GetCost( (*successor)->m_UserState );
+		if( Space->stamp.size() != m_Graph->GetNodeCount() )
+		{
+			Space->distance.resize( m_Graph->GetNodeCount() );
+			Space->stamp.assign( m_Graph->GetNodeCount(), 0u );
+		}
 
-				// Now we need to find whether the node is on the open or closed lists If it is but the node that is already on them is better (lower g) then we can forget about this successor
+		for( size_t i = m_Next ++; i < m_Sources->size(); i = m_Next ++ )
+		{
+			Search( *Space, i );
+		}
+	}
 
-				// First linear search of open list to find node
+	// Dijkstra from the Index'th start until every node of the other list is settled or nothing more can be reached
+	void Search( Workspace &Space, size_t Index )
+	{
+		const CSRGraph &graph = *m_Graph;
+		vector< float > &distance = Space.distance;
+		vector< unsigned int > &stamp = Space.stamp;
+		vector< Entry > &heap = Space.heap;
+		greater< Entry > compare;
 
-				typename vector< Node * >::iterator openlist_result;
+		if( ++ Space.generation == 0 )
+		{
+			// the stamps have wrapped round, this happens once every 2^32 searches
+			fill( stamp.begin(), stamp.end(), 0u );
+			Space.generation = 1;
+		}
 
-				for( openlist_result = m_OpenList.begin(); openlist_result != m_OpenList.end(); openlist_result ++ )
-				{
-					if( (*openlist_result)->m_UserState.IsSameState( (*successor)->m_UserState ) )
-					{
-						break;
-					}
-				}
+		unsigned int generation = Space.generation;
+		unsigned int source = (*m_Sources)[Index];
+		unsigned int remaining = m_DistinctTargets;
+		size_t columns = m_Reverse ? m_Sources->size() : m_Targets->size();
 
-				if( openlist_result != m_OpenList.end() )
-				{
+		heap.clear();
+		distance[source] = 0.0f;
+		stamp[source] = generation;
+		heap.push_back( Entry( 0.0f, source ) );
 
-					// we found this state on open
+		while( !heap.empty() && remaining )
+		{
+			pop_heap( heap.begin(), heap.end(), compare );
+			Entry top = heap.back();
+			heap.pop_back();
 
-					if( (*openlist_result)->g <= newg )
-					{
-						FreeNode( (*successor) );
+			unsigned int n = top.second;
 
-						// the one on Open is cheaper than this one
-						continue;
-					}
-				}
+			if( top.first > distance[n] )
+			{
+				continue; // stale entry, n was reached more cheaply since
+			}
 
-				typename vector< Node * >::iterator closedlist_result;
+			Space.settled ++;
 
-				for( closedlist_result = m_ClosedList.begin(); closedlist_result != m_ClosedList.end(); closedlist_result ++ )
+			if( m_FirstSlot[n] != NO_SLOT )
+			{
+				for( unsigned int slot = m_FirstSlot[n]; slot != NO_SLOT; slot = m_NextSlot[slot] )
 				{
-					if( (*closedlist_result)->m_UserState.IsSameState( (*successor)->m_UserState ) )
-					{
-						break;
-					}
+					// a backward search from target Index fills column Index, a forward one row Index
+					size_t cell = m_Reverse ? slot * columns + Index : Index * columns + slot;
+					(*m_Costs)[cell] = top.first;
 				}
 
-				if( closedlist_result != m_ClosedList.end() )
-				{
+				remaining --;
+			}
 
-					// we found this state on closed
+			unsigned int begin = m_Reverse ? graph.InEdgesBegin( n ) : graph.EdgesBegin( n );
+			unsigned int end = m_Reverse ? graph.InEdgesEnd( n ) : graph.EdgesEnd( n );
 
-					if( (*closedlist_result)->g <= newg )
-					{
-						// the one on Closed is cheaper than this one
-						FreeNode( (*successor) );
+			for( unsigned int e = begin; e < end; e ++ )
+			{
+				unsigned int edge = m_Reverse ? graph.GetInEdgeForward( e ) : e;
+				unsigned int next = m_Reverse ? graph.GetInEdgeSource( e ) : graph.GetEdgeTarget( e );
+				float d = top.first + graph.GetEdgeWeight( edge );
 
-						continue;
-					}
+				if( stamp[next] != generation || d < distance[next] )
+				{
+					stamp[next] = generation;
+					distance[next] = d;
+					heap.push_back( Entry( d, next ) );
+					push_heap( heap.begin(), heap.end(), compare );
 				}
+			}
+		}
+	}
 
-				// This node is the best node so far with this particular state so lets keep it and set up its A* specific data ...
+	vector< Workspace > m_Workspaces;
+
+	// The node lists of the current Compute, the other list as the targets when the searches run backwards. Slots are
+	// positions in m_Targets, m_FirstSlot gives the first slot each node fills (NO_SLOT for nodes that aren't
+	// targets) and m_NextSlot chains on to any later slot for the same node.
+	const CSRGraph *m_Graph;
+	const vector< unsigned int > *m_Sources;
+	const vector< unsigned int > *m_Targets;
+	vector< float > *m_Costs;
+	bool m_Reverse;
+	vector< unsigned int > m_FirstSlot;
+	vector< unsigned int > m_NextSlot;
+	unsigned int m_DistinctTargets;
+	atomic< size_t > m_Next; // next search to hand out
+};
 
-				(*successor)->parent = n;
-				(*successor)->g = newg;
-				(*successor)->h = (*successor)->m_UserState.GoalDistanceEstimate( m_Goal->m_UserState );
-				(*successor)->f = (*successor)->g + (*successor)->h;
+// Distance Matrix Ends -------------------------------------------------------------------------------------------------------------------------
 
-				// Successor is in closed list and the new copy is cheaper then
-				// 1 - Update old version of this node in closed list
-				// 2 - Move it from closed to open list
-				// 3 - Sort heap again in open list
 
-				if( closedlist_result != m_ClosedList.end() )
-				{
-					// Update closed node with successor node AStar data
-					(*closedlist_result)->parent = (*successor)->parent;
-					(*closedlist_result)->g      = (*successor)->g;
-					(*closedlist_result)->h      = (*successor)->h;
-					(*closedlist_result)->f      = (*successor)->f;
 
-					// Free successor node
-					FreeNode( (*successor) );
 
-					// Push closed node into open list
-					m_OpenList.push_back( (*closedlist_result) );
+// Path Cache Code Starts -----------------------------------------------------------------------------------------------------------------------
 
-					// Remove closed node from closed list
-					m_ClosedList.erase( closedlist_result );
+// Least recently used cache of solutions, for traffic where the same few start/goal pairs come up again and again.
+// Solutions are keyed by start, goal and a graph version which the caller bumps whenever costs change, so solutions
+// from before a change are never returned and just age out. The cache holds at most MaxStates path states in all,
+// dropping the least recently used solutions to make room.
+//
+// Any part of a shortest path is itself a shortest path, so a query whose start and goal both lie on a cached
+// solution, in that order, is answered with the stretch between them. That only holds if the cached solutions are
+// optimal, so subpath answers can be turned off for searches that aren't (with SetSuboptimalBound, say).
+//
+// One mutex guards the cache, searches run outside it so any number of threads can share one cache, each with its own
+// search object. The UserState must provide Hash(), as for AStarHashIndex, and its GetCost is used to cost subpaths.
 
-					// Sort back element into heap
-					push_heap( m_OpenList.begin(), m_OpenList.end(), HeapCompare_f() );
+template <class SearchType> class AStarPathCache
+{
+public:
 
-					// Here we have found a new state which is already CLOSED
+	typedef typename SearchType::UserStateType UserState;
+	typedef typename SearchType::SearchResult SearchResult;
 
-				}
+	AStarPathCache( size_t MaxStates, bool Subpaths = true ) :
+		m_MaxStates( MaxStates ),
+		m_Subpaths( Subpaths ),
+		m_StateCount( 0 ),
+		m_Hits( 0 ),
+		m_SubpathHits( 0 ),
+		m_Misses( 0 )
+	{
+	}
 
-				// Successor in open list
-				// 1 - Update old version of this node in open list
-				// 2 - sort heap again in open list
+	// Looks for a solution from Start to Goal at Version, filling Result with it as a successful search would
+	bool Find( UserState &Start, UserState &Goal, uint64_t Version, SearchResult &Result )
+	{
+		lock_guard< mutex > lock( m_Mutex );
 
-				else if( openlist_result != m_OpenList.end() )
-				{
-					// Update open node with successor node AStar data
-					(*openlist_result)->parent = (*successor)->parent;
-					(*openlist_result)->g      = (*successor)->g;
-					(*openlist_result)->h      = (*successor)->h;
-					(*openlist_result)->f      = (*successor)->f;
+		EntryIterator entry = FindEntry( Start, Goal, Version );
 
-					// Free successor node
-					FreeNode( (*successor) );
+		if( entry != m_Entries.end() )
+		{
+			Touch( entry );
+			Answer( entry, 0, entry->path.size() - 1, Result );
+			m_Hits ++;
+			return true;
+		}
 
-					// re-make the heap
+		if( m_Subpaths && FindSubpath( Start, Goal, Version, Result ) )
+		{
+			m_SubpathHits ++;
+			return true;
+		}
 
-					make_heap( m_OpenList.begin(), m_OpenList.end(), HeapCompare_f() );
-				}
+		m_Misses ++;
+		return false;
+	}
 
-				// New successor
-				// 1 - Move it from successors to open list
-				// 2 - sort heap again in open list
+	// Adds the solution a search found from Start to Goal at Version, Result being the search's successful result
+	void Insert( UserState &Start, UserState &Goal, uint64_t Version, const SearchResult &Result )
+	{
+		if( Result.path.empty() || Result.path.size() > m_MaxStates )
+		{
+			return;
+		}
 
-				else
-				{
-					// Push successor node into open list
-					m_OpenList.push_back( (*successor) );
+		Entry added;
+		added.start = Start;
+		added.goal = Goal;
+		added.version = Version;
+		added.path = Result.path;
+		added.costs.resize( added.path.size() );
+		added.costs[0] = 0.0f;
 
-					// Sort back element into heap
-					push_heap( m_OpenList.begin(), m_OpenList.end(), HeapCompare_f() );
-				}
+		// the cost from the start to each state, for costing subpaths
+		for( size_t i = 1; i < added.path.size(); i ++ )
+		{
+			added.costs[i] = added.costs[i - 1] + added.path[i - 1].GetCost( added.path[i] );
+		}
 
-			}
+		lock_guard< mutex > lock( m_Mutex );
 
-			// push n onto Closed, as we have expanded it now
+		if( FindEntry( Start, Goal, Version ) != m_Entries.end() )
+		{
+			return; // another thread got there first
+		}
 
-			m_ClosedList.push_back( n );
+		m_Entries.push_front( added );
 
-		} // end else (not goal so expand)
+		EntryIterator entry = m_Entries.begin();
 
- 		return m_State; // Succeeded bool is false at this point.
+		m_ByKey.insert( make_pair( KeyHash( Start, Goal, Version ), entry ) );
+
+		if( m_Subpaths )
+		{
+			for( size_t i = 0; i < entry->path.size(); i ++ )
+			{
+				m_ByState.insert( make_pair( entry->path[i].Hash(), Occurrence( entry, i ) ) );
+			}
+		}
+
+		m_StateCount += entry->path.size();
 
+		while( m_StateCount > m_MaxStates )
+		{
+			Erase( -- m_Entries.end() );
+		}
 	}
 
-	// User calls this to add a successor to a list of successors when expanding the search frontier
-	bool AddSuccessor( UserState &State )
+	// Answers from the cache if it can, otherwise searches with Engine and caches the solution. Engine must not be in
+	// the middle of a search. Returns the search state, as Search does.
+	unsigned int Search( SearchType &Engine, UserState &Start, UserState &Goal, uint64_t Version, SearchResult &Result )
 	{
-		Node *node = AllocateNode();
-
-		if( node )
+		if( Find( Start, Goal, Version, Result ) )
 		{
-			node->m_UserState = State;
+			return SearchType::SEARCH_STATE_SUCCEEDED;
+		}
 
-			m_Successors.push_back( node );
+		Engine.SetStartAndGoalStates( Start, Goal );
 
-			return true;
+		unsigned int state = Engine.Search( Result );
+
+		if( state == SearchType::SEARCH_STATE_SUCCEEDED )
+		{
+			Engine.FreeSolutionNodes();
+			Insert( Start, Goal, Version, Result );
 		}
 
-		return false;
+		return state;
 	}
 
-	// Free the solution nodes. This is done to clean up all used Node memory when you are done with the search
-	void FreeSolutionNodes()
+	void Clear()
 	{
-		Node *n = m_Start;
+		lock_guard< mutex > lock( m_Mutex );
 
-		if( m_Start->child )
-		{
-			do
-			{
-				Node *del = n;
-				n = n->child;
-				FreeNode( del );
+		m_Entries.clear();
+		m_ByKey.clear();
+		m_ByState.clear();
+		m_StateCount = 0;
+	}
 
-				del = NULL;
+	// Lookups answered by a whole cached solution, by part of one, and not at all
+	unsigned long long GetHits() { lock_guard< mutex > lock( m_Mutex ); return m_Hits; }
+	unsigned long long GetSubpathHits() { lock_guard< mutex > lock( m_Mutex ); return m_SubpathHits; }
+	unsigned long long GetMisses() { lock_guard< mutex > lock( m_Mutex ); return m_Misses; }
 
-			} while( n != m_Goal );
+	size_t GetSolutionCount() { lock_guard< mutex > lock( m_Mutex ); return m_Entries.size(); }
+	size_t GetStateCount() { lock_guard< mutex > lock( m_Mutex ); return m_StateCount; }
 
-			FreeNode( n ); // Delete the goal
+private:
 
-		}
-		else
-		{
-			// if the start node is the solution we need to just delete the start and goal nodes
-			FreeNode( m_Start );
-			FreeNode( m_Goal );
-		}
+	class Entry
+	{
+		public:
 
-	}
+			UserState start;
+			UserState goal;
+			uint64_t version;
+			vector< UserState > path;
+			vector< float > costs; // costs[i] is the cost from the start to path[i]
+	};
 
-	// Functions for traversing the solution
+	typedef typename list< Entry >::iterator EntryIterator;
+	typedef pair< EntryIterator, size_t > Occurrence; // a solution and a position on its path
 
-	// Get start node
-	UserState *GetSolutionStart()
+	static size_t Combine( size_t Seed, size_t Value )
 	{
-		m_CurrentSolutionNode = m_Start;
-		if( m_Start )
-		{
-			return &m_Start->m_UserState;
-		}
-		else
-		{
-			return NULL;
-		}
+		return Seed ^ ( Value + (size_t)0x9e3779b97f4a7c15ULL + ( Seed << 6 ) + ( Seed >> 2 ) );
 	}
 
-	// Get next node
-	UserState *GetSolutionNext()
+	static size_t KeyHash( UserState &Start, UserState &Goal, uint64_t Version )
 	{
-		if( m_CurrentSolutionNode )
-		{
-			if( m_CurrentSolutionNode->child )
-			{
+		return Combine( Combine( Start.Hash(), Goal.Hash() ), (size_t)Version );
+	}
 
-				Node *child = m_CurrentSolutionNode->child;
+	EntryIterator FindEntry( UserState &Start, UserState &Goal, uint64_t Version )
+	{
+		typedef typename unordered_multimap< size_t, EntryIterator >::iterator KeyIterator;
 
-				m_CurrentSolutionNode = m_CurrentSolutionNode->child;
+		pair< KeyIterator, KeyIterator > range = m_ByKey.equal_range( KeyHash( Start, Goal, Version ) );
 
-				return &child->m_UserState;
+		for( KeyIterator i = range.first; i != range.second; i ++ )
+		{
+			Entry &entry = *i->second;
+
+			if( entry.version == Version && entry.start.IsSameState( Start ) && entry.goal.IsSameState( Goal ) )
+			{
+				return i->second;
 			}
 		}
 
-		return NULL;
+		return m_Entries.end();
 	}
 
-	// Get end node
-	UserState *GetSolutionEnd()
+	// Looks for a cached solution passing through Start and later through Goal
+	bool FindSubpath( UserState &Start, UserState &Goal, uint64_t Version, SearchResult &Result )
 	{
-		m_CurrentSolutionNode = m_Goal;
-		if( m_Goal )
-		{
-			return &m_Goal->m_UserState;
-		}
-		else
-		{
-			return NULL;
-		}
-	}
+		typedef typename unordered_multimap< size_t, Occurrence >::iterator StateIterator;
 
-	// Step solution iterator backwards
-	UserState *GetSolutionPrev()
-	{
-		if( m_CurrentSolutionNode )
+		pair< StateIterator, StateIterator > starts = m_ByState.equal_range( Start.Hash() );
+		pair< StateIterator, StateIterator > goals = m_ByState.equal_range( Goal.Hash() );
+
+		for( StateIterator s = starts.first; s != starts.second; s ++ )
 		{
-			if( m_CurrentSolutionNode->parent )
-			{
+			Entry &entry = *s->second.first;
 
-				Node *parent = m_CurrentSolutionNode->parent;
+			if( entry.version != Version || !entry.path[ s->second.second ].IsSameState( Start ) )
+			{
+				continue;
+			}
 
-				m_CurrentSolutionNode = m_CurrentSolutionNode->parent;
+			for( StateIterator g = goals.first; g != goals.second; g ++ )
+			{
+				if( g->second.first == s->second.first && g->second.second >= s->second.second &&
+					entry.path[ g->second.second ].IsSameState( Goal ) )
+				{
+					EntryIterator found = s->second.first;
 
-				return &parent->m_UserState;
+					Touch( found );
+					Answer( found, s->second.second, g->second.second, Result );
+					return true;
+				}
 			}
 		}
 
-		return NULL;
+		return false;
 	}
 
-	// Get final cost of solution
-	// Returns FLTMAX if goal is not defined or there is no solution
-	float GetSolutionCost()
+	// Fills Result with the stretch of a solution from position First to Last
+	void Answer( EntryIterator Found, size_t First, size_t Last, SearchResult &Result )
 	{
-		if( m_Goal && m_State == SEARCH_STATE_SUCCEEDED )
-		{
-			return m_Goal->g;
-		}
-		else
-		{
-			return FLT_MAX;
-		}
+		Result = SearchResult();
+		Result.state = SearchType::SEARCH_STATE_SUCCEEDED;
+		Result.path.assign( Found->path.begin() + First, Found->path.begin() + Last + 1 );
+		Result.cost = Found->costs[Last] - Found->costs[First];
 	}
 
-	// For debugging it is useful to be able to view the open and closed list at each step, here are two functions to allow that.
-
-	UserState *GetOpenListStart()
+	// Moves a solution to the front, the most recently used end. Splicing keeps the iterators to it valid.
+	void Touch( EntryIterator Found )
 	{
-		float f,g,h;
-		return GetOpenListStart( f,g,h );
+		m_Entries.splice( m_Entries.begin(), m_Entries, Found );
 	}
 
-	UserState *GetOpenListStart( float &f, float &g, float &h )
+	void Erase( EntryIterator Found )
 	{
-		iterDbgOpen = m_OpenList.begin();
-		if( iterDbgOpen != m_OpenList.end() )
+		typedef typename unordered_multimap< size_t, EntryIterator >::iterator KeyIterator;
+		typedef typename unordered_multimap< size_t, Occurrence >::iterator StateIterator;
+
+		pair< KeyIterator, KeyIterator > keys = m_ByKey.equal_range( KeyHash( Found->start, Found->goal, Found->version ) );
+
+		for( KeyIterator i = keys.first; i != keys.second; i ++ )
 		{
-			f = (*iterDbgOpen)->f;
-			g = (*iterDbgOpen)->g;
-			h = (*iterDbgOpen)->h;
-			return &(*iterDbgOpen)->m_UserState;
+			if( i->second == Found )
+			{
+				m_ByKey.erase( i );
+				break;
+			}
 		}
 
-		return NULL;
+		if( m_Subpaths )
+		{
+			for( size_t p = 0; p < Found->path.size(); p ++ )
+			{
+				pair< StateIterator, StateIterator > states = m_ByState.equal_range( Found->path[p].Hash() );
+
+				for( StateIterator i = states.first; i != states.second; i ++ )
+				{
+					if( i->second.first == Found && i->second.second == p )
+					{
+						m_ByState.erase( i );
+						break;
+					}
+				}
+			}
+		}
+
+		m_StateCount -= Found->path.size();
+		m_Entries.erase( Found );
 	}
 
-	UserState *GetOpenListNext()
+	// the cache holds pointers into itself, so it can't be copied
+	AStarPathCache( const AStarPathCache & );
+	AStarPathCache &operator=( const AStarPathCache & );
+
+	size_t m_MaxStates;
+	bool m_Subpaths;
+
+	mutex m_Mutex;
+
+	// Solutions, the most recently used first, found through their key hash and, for subpaths, through the hash of
+	// every state on them
+	list< Entry > m_Entries;
+	unordered_multimap< size_t, EntryIterator > m_ByKey;
+	unordered_multimap< size_t, Occurrence > m_ByState;
+	size_t m_StateCount;
+
+	unsigned long long m_Hits;
+	unsigned long long m_SubpathHits;
+	unsigned long long m_Misses;
+};
+
+// Path Cache Ends ------------------------------------------------------------------------------------------------------------------------------
+
+
+
+
+// Benchmark Code Starts ------------------------------------------------------------------------------------------------------------------------
+
+// Synthetic graphs and fixed query sets for timing the searches. Graphs and queries come from a small generator of
+// our own rather than rand(), so a given kind, size and seed gives the same graph and the same queries on every
+// platform and every version of the code, and results from two builds can be compared row by row.
+//
+// Every graph has coordinates and no edge is cheaper than the straight line between its ends, so the Euclidean
+// estimate CSRGraphNode uses stays admissible. Size is the side of the square the nodes are spread over, graphs
+// have about Size * Size nodes.
+//
+//   grid        4-connected lattice, each edge costs 1 to 2 times its length
+//   geometric   random points joined to every other point within a fixed radius, about 6 neighbours each
+//   road        jittered lattice with a fast arterial every 8 rows and columns, slower local streets, some diagonals
+//               and about 1 street in 10 missing
+
+class BenchmarkRandom // xorshift64*, fixed so generated graphs never change under us
+{
+public:
+
+	BenchmarkRandom( uint64_t Seed ) :
+		m_State( Seed * 0x9E3779B97F4A7C15ULL + 1 )
 	{
-		float f,g,h;
-		return GetOpenListNext( f,g,h );
 	}
 
-	UserState *GetOpenListNext( float &f, float &g, float &h )
+	uint32_t Next()
 	{
-		iterDbgOpen++;
-		if( iterDbgOpen != m_OpenList.end() )
-		{
-			f = (*iterDbgOpen)->f;
-			g = (*iterDbgOpen)->g;
-			h = (*iterDbgOpen)->h;
-			return &(*iterDbgOpen)->m_UserState;
-		}
+		m_State ^= m_State >> 12;
+		m_State ^= m_State << 25;
+		m_State ^= m_State >> 27;
 
-		return NULL;
+		return (uint32_t)( ( m_State * 0x2545F4914F6CDD1DULL ) >> 32 );
 	}
 
-	UserState *GetClosedListStart()
+	// uniform in [0, Range)
+	unsigned int Below( unsigned int Range )
 	{
-		float f,g,h;
-		return GetClosedListStart( f,g,h );
+		return (unsigned int)( ( (uint64_t)Next() * Range ) >> 32 );
 	}
 
-	UserState *GetClosedListStart( float &f, float &g, float &h )
+	// uniform in [0, 1)
+	float Unit()
 	{
-		iterDbgClosed = m_ClosedList.begin();
-		if( iterDbgClosed != m_ClosedList.end() )
-		{
-			f = (*iterDbgClosed)->f;
-			g = (*iterDbgClosed)->g;
-			h = (*iterDbgClosed)->h;
+		return (float)( Next() >> 8 ) * ( 1.0f / 16777216.0f );
+	}
 
-			return &(*iterDbgClosed)->m_UserState;
-		}
+private:
 
-		return NULL;
-	}
+	uint64_t m_State;
+};
 
-	UserState *GetClosedListNext()
-	{
-		float f,g,h;
-		return GetClosedListNext( f,g,h );
-	}
+static void BenchmarkAddRoad( vector< CSREdge > &Edges, const vector< float > &X, const vector< float > &Y, unsigned int A, unsigned int B, float Slowness )
+{
+	float dx = X[A] - X[B];
+	float dy = Y[A] - Y[B];
+	float weight = sqrtf( dx * dx + dy * dy ) * Slowness;
+
+	CSREdge there = { A, B, weight };
+	CSREdge back = { B, A, weight };
+
+	Edges.push_back( there );
+	Edges.push_back( back );
+}
+
+// Builds a benchmark graph, returns false if Kind is not one of grid, geometric or road
+bool BuildBenchmarkGraph( const string &Kind, unsigned int Size, unsigned int Seed, CSRGraph &Graph )
+{
+	BenchmarkRandom random( Seed );
+	unsigned int V = Size * Size;
+	vector< float > x( V ), y( V );
+	vector< CSREdge > edges;
 
-	UserState *GetClosedListNext( float &f, float &g, float &h )
+	if( Kind == "grid" || Kind == "road" )
 	{
-		iterDbgClosed++;
-		if( iterDbgClosed != m_ClosedList.end() )
+		bool road = Kind == "road";
+
+		for( unsigned int n = 0; n < V; n ++ )
 		{
-			f = (*iterDbgClosed)->f;
-			g = (*iterDbgClosed)->g;
-			h = (*iterDbgClosed)->h;
+			x[n] = (float)( n % Size );
+			y[n] = (float)( n / Size );
 
-			return &(*iterDbgClosed)->m_UserState;
+			if( road )
+			{
+				x[n] += random.Unit() * 0.6f;
+				y[n] += random.Unit() * 0.6f;
+			}
 		}
 
-		return NULL;
-	}
-
-	// Get the number of steps
-
-	int GetStepCount() { return m_Steps; }
+		for( unsigned int row = 0; row < Size; row ++ )
+		{
+			for( unsigned int column = 0; column < Size; column ++ )
+			{
+				unsigned int n = row * Size + column;
 
+				if( !road )
+				{
+					if( column + 1 < Size ) BenchmarkAddRoad( edges, x, y, n, n + 1, 1.0f + random.Unit() );
+					if( row + 1 < Size ) BenchmarkAddRoad( edges, x, y, n, n + Size, 1.0f + random.Unit() );
+					continue;
+				}
 
+				// streets along an arterial row run at full speed, the rest at a half to a third of it
+				if( column + 1 < Size && random.Below( 10 ) )
+				{
+					BenchmarkAddRoad( edges, x, y, n, n + 1, row % 8 == 0 ? 1.0f : 2.0f + random.Unit() );
+				}
 
-private: // methods
+				if( row + 1 < Size && random.Below( 10 ) )
+				{
+					BenchmarkAddRoad( edges, x, y, n, n + Size, column % 8 == 0 ? 1.0f : 2.0f + random.Unit() );
+				}
 
-	// This is called when a search fails or is canceled to free all used memory
-	void FreeAllNodes()
+				if( column + 1 < Size && row + 1 < Size && random.Below( 5 ) == 0 )
+				{
+					BenchmarkAddRoad( edges, x, y, n, n + Size + 1, 2.0f + random.Unit() );
+				}
+			}
+		}
+	}
+	else if( Kind == "geometric" )
 	{
-		// iterate open list and delete all nodes
-		typename vector< Node * >::iterator iterOpen = m_OpenList.begin();
+		// one point per unit of area on average, a radius of sqrt( 6 / pi ) gives about 6 neighbours
+		const float radius = 1.38f;
 
-		while( iterOpen != m_OpenList.end() )
+		// bucket the points into cells one radius across so each only looks at its own and the neighbouring cells
+		unsigned int cells = max( 1u, (unsigned int)( Size / radius ) );
+		float cellSize = (float)Size / cells;
+		vector< vector< unsigned int > > cell( (size_t)cells * cells );
+
+		for( unsigned int n = 0; n < V; n ++ )
 		{
-			Node *n = (*iterOpen);
-			FreeNode( n );
+			x[n] = random.Unit() * Size;
+			y[n] = random.Unit() * Size;
 
-			iterOpen ++;
+			unsigned int cx = min( cells - 1, (unsigned int)( x[n] / cellSize ) );
+			unsigned int cy = min( cells - 1, (unsigned int)( y[n] / cellSize ) );
+			cell[ (size_t)cy * cells + cx ].push_back( n );
 		}
 
-		m_OpenList.clear();
+		for( unsigned int n = 0; n < V; n ++ )
+		{
+			int cx = min( (int)cells - 1, (int)( x[n] / cellSize ) );
+			int cy = min( (int)cells - 1, (int)( y[n] / cellSize ) );
 
-		// iterate closed list and delete unused nodes
-		typename vector< Node * >::iterator iterClosed;
+			for( int oy = cy - 1; oy <= cy + 1; oy ++ )
+			{
+				for( int ox = cx - 1; ox <= cx + 1; ox ++ )
+				{
+					if( ox < 0 || oy < 0 || ox >= (int)cells || oy >= (int)cells )
+					{
+						continue;
+					}
 
-		for( iterClosed = m_ClosedList.begin(); iterClosed != m_ClosedList.end(); iterClosed ++ )
-		{
-			Node *n = (*iterClosed);
-			FreeNode( n );
+					const vector< unsigned int > &points = cell[ (size_t)oy * cells + ox ];
+
+					for( size_t i = 0; i < points.size(); i ++ )
+					{
+						unsigned int m = points[i];
+						float dx = x[n] - x[m];
+						float dy = y[n] - y[m];
+
+						if( m > n && dx * dx + dy * dy <= radius * radius )
+						{
+							BenchmarkAddRoad( edges, x, y, n, m, 1.0f );
+						}
+					}
+				}
+			}
 		}
+	}
+	else
+	{
+		return false;
+	}
 
-		m_ClosedList.clear();
+	Graph.Build( V, edges );
+	Graph.SetCoordinates( x, y );
 
-		// delete the goal
+	return true;
+}
 
-		FreeNode(m_Goal);
+// Count start and goal pairs drawn uniformly from the graph's nodes. Some may have no route between them.
+void BuildBenchmarkQueries( const CSRGraph &Graph, unsigned int Count, unsigned int Seed, vector< pair< unsigned int, unsigned int > > &Queries )
+{
+	BenchmarkRandom random( Seed ^ 0x51ED270B );
+
+	Queries.clear();
+
+	for( unsigned int i = 0; i < Count; i ++ )
+	{
+		unsigned int start = random.Below( Graph.GetNodeCount() );
+		unsigned int goal = random.Below( Graph.GetNodeCount() );
+
+		Queries.push_back( make_pair( start, goal ) );
 	}
+}
 
+// What one engine did on one query set
+class BenchmarkResult
+{
+public:
 
-	// This call is made by the search class when the search ends. A lot of nodes may be
-	// created that are still present when the search ends. They will be deleted by this
-	// routine once the search ends
-	void FreeUnusedNodes()
+	string engine;
+	string graph;
+	unsigned int size;
+	unsigned int nodes;
+	unsigned int edges;
+	unsigned int queries;
+	unsigned int failed; // queries with no route
+	double qps;
+	double p50; // latency percentiles in microseconds
+	double p99;
+	double expanded; // mean nodes expanded per query
+	unsigned int peakNodes; // most nodes allocated at once over the whole run
+	size_t bytes; // memory held by the search object at the end of the run
+
+	BenchmarkResult() :
+		size( 0 ), nodes( 0 ), edges( 0 ), queries( 0 ), failed( 0 ), qps( 0.0 ), p50( 0.0 ), p99( 0.0 ), expanded( 0.0 ),
+		peakNodes( 0 ), bytes( 0 )
 	{
-		// iterate open list and delete unused nodes
-		typename vector< Node * >::iterator iterOpen = m_OpenList.begin();
+	}
+};
 
-		while( iterOpen != m_OpenList.end() )
-		{
-			Node *n = (*iterOpen);
+static const char *BenchmarkColumns = "engine,graph,size,nodes,edges,queries,failed,qps,p50_us,p99_us,expanded,peak_nodes,bytes";
 
-			if( !n->child )
-			{
-				FreeNode( n );
+// Runs every query one after another on a single search object, the way a routing server would, so the node pool
+// and buffers are warm after the first few. Each query is timed from SetStartAndGoalStates to the end of
+// FreeSolutionNodes. SearchType is an AStarSearch instantiation on CSRGraphNode that does no tracing, or another
+// engine with the same interface.
+template <class SearchType> void RunBenchmark( const char *Engine, const CSRGraph &Graph, const vector< pair< unsigned int, unsigned int > > &Queries, BenchmarkResult &Result )
+{
+	typedef typename SearchType::Clock Clock;
 
-				n = NULL;
-			}
+	SearchType astarsearch;
+	typename SearchType::SearchResult result;
+	vector< double > latency;
+	unsigned long long expanded = 0;
 
-			iterOpen ++;
-		}
+	Result.engine = Engine;
+	Result.nodes = Graph.GetNodeCount();
+	Result.edges = Graph.GetEdgeCount();
+	Result.queries = (unsigned int)Queries.size();
+	Result.failed = 0;
 
-		m_OpenList.clear();
+	typename Clock::time_point started = Clock::now();
 
-		// iterate closed list and delete unused nodes
-		typename vector< Node * >::iterator iterClosed;
+	for( size_t i = 0; i < Queries.size(); i ++ )
+	{
+		typename Clock::time_point queryStarted = Clock::now();
 
-		for( iterClosed = m_ClosedList.begin(); iterClosed != m_ClosedList.end(); iterClosed ++ )
+		CSRGraphNode nodeStart( &Graph, Queries[i].first ), nodeEnd( &Graph, Queries[i].second );
+		astarsearch.SetStartAndGoalStates( nodeStart, nodeEnd );
+
+		if( astarsearch.Search( result ) == SearchType::SEARCH_STATE_SUCCEEDED )
 		{
-			Node *n = (*iterClosed);
+			astarsearch.FreeSolutionNodes();
+		}
+		else
+		{
+			Result.failed ++;
+		}
 
-			if( !n->child )
-			{
-				FreeNode( n );
-				n = NULL;
+		latency.push_back( chrono::duration< double, micro >( Clock::now() - queryStarted ).count() );
+		expanded += result.nodesExpanded;
+	}
 
-			}
-		}
+	double seconds = chrono::duration< double >( Clock::now() - started ).count();
 
-		m_ClosedList.clear();
+	sort( latency.begin(), latency.end() );
+
+	if( !latency.empty() )
+	{
+		Result.qps = seconds > 0.0 ? latency.size() / seconds : 0.0;
+		Result.p50 = latency[ ( latency.size() - 1 ) / 2 ];
+		Result.p99 = latency[ ( latency.size() - 1 ) * 99 / 100 ];
+		Result.expanded = (double)expanded / latency.size();
+	}
+
+	Result.peakNodes = (unsigned int)astarsearch.GetPeakAllocatedNodeCount();
+	Result.bytes = astarsearch.GetMemoryUsage();
+}
+
+// One line of the machine readable output, in the order of BenchmarkColumns
+void WriteBenchmarkResult( ostream &Out, const BenchmarkResult &Result )
+{
+	Out << Result.engine << ',' << Result.graph << ',' << Result.size << ',' << Result.nodes << ',' << Result.edges << ','
+		<< Result.queries << ',' << Result.failed << ',' << Result.qps << ',' << Result.p50 << ',' << Result.p99 << ','
+		<< Result.expanded << ',' << Result.peakNodes << ',' << Result.bytes << '\n';
+}
 
-	}
+// Reads results written by WriteBenchmarkResult, skipping the header. Returns false if the file can't be opened.
+bool ReadBenchmarkResults( const char *Path, vector< BenchmarkResult > &Results )
+{
+	ifstream file( Path );
 
-	// Node memory management
-	Node *AllocateNode()
+	if( !file )
 	{
-		m_AllocateNodeCount ++;
-		Node *p = new Node;
-		return p;
+		return false;
 	}
 
-	void FreeNode( Node *node )
+	string line;
+
+	while( getline( file, line ) )
 	{
-		m_AllocateNodeCount --;
-		delete node;
-	}
+		for( size_t i = 0; i < line.size(); i ++ )
+		{
+			if( line[i] == ',' )
+			{
+				line[i] = ' ';
+			}
+		}
 
-private: // data
+		istringstream fields( line );
+		BenchmarkResult result;
 
-	// Heap (simple vector but used as a heap)
-	vector< Node *> m_OpenList;
+		if( fields >> result.engine >> result.graph >> result.size >> result.nodes >> result.edges >> result.queries >>
+			result.failed >> result.qps >> result.p50 >> result.p99 >> result.expanded >> result.peakNodes >> result.bytes )
+		{
+			Results.push_back( result );
+		}
+	}
 
-	// Closed list is a vector.
-	vector< Node * > m_ClosedList;
+	return true;
+}
 
-	// Successors is a vector filled out by the user each time successors to a node
-	// are generated
-	vector< Node * > m_Successors;
+// Compares a run against a baseline run of the same benchmark and reports, on Out, every result that got worse.
+// Nodes expanded and peak nodes don't depend on timing, so any increase is reported. Throughput and latency are
+// noisy, so only changes larger than Tolerance (0.1 for 10%) are, twice that for p99 which rests on the few slowest
+// queries. Returns the number of regressions.
+unsigned int CompareBenchmarkResults( const vector< BenchmarkResult > &Baseline, const vector< BenchmarkResult > &Current, double Tolerance, ostream &Out )
+{
+	unsigned int regressions = 0;
 
-	// State
-	unsigned int m_State;
+	for( size_t i = 0; i < Current.size(); i ++ )
+	{
+		const BenchmarkResult &now = Current[i];
 
-	// Counts steps
-	int m_Steps;
+		for( size_t j = 0; j < Baseline.size(); j ++ )
+		{
+			const BenchmarkResult &then = Baseline[j];
 
-	// Start and goal state pointers
-	Node *m_Start;
-	Node *m_Goal;
+			if( then.engine != now.engine || then.graph != now.graph || then.size != now.size || then.queries != now.queries )
+			{
+				continue;
+			}
 
-	Node *m_CurrentSolutionNode;
+			string label = now.engine + " " + now.graph;
 
+			if( now.expanded > then.expanded * 1.0001 )
+			{
+				Out << label << ": nodes expanded went from " << then.expanded << " to " << now.expanded << '\n';
+				regressions ++;
+			}
 
+			if( now.peakNodes > then.peakNodes )
+			{
+				Out << label << ": peak nodes went from " << then.peakNodes << " to " << now.peakNodes << '\n';
+				regressions ++;
+			}
 
-	//Debug : need to keep these two iterators around for the user Debug functions
-	typename vector< Node * >::iterator iterDbgOpen;
-	typename vector< Node * >::iterator iterDbgClosed;
+			if( now.qps < then.qps * ( 1.0 - Tolerance ) )
+			{
+				Out << label << ": queries per second went from " << then.qps << " to " << now.qps << '\n';
+				regressions ++;
+			}
 
-	// debugging : count memory allocation and free's
-	int m_AllocateNodeCount;
+			if( now.p50 > then.p50 * ( 1.0 + Tolerance ) )
+			{
+				Out << label << ": p50 latency went from " << then.p50 << " us to " << now.p50 << " us\n";
+				regressions ++;
+			}
 
+			if( now.p99 > then.p99 * ( 1.0 + 2.0 * Tolerance ) )
+			{
+				Out << label << ": p99 latency went from " << then.p99 << " us to " << now.p99 << " us\n";
+				regressions ++;
+			}
 
-};
+			break;
+		}
+	}
 
+	return regressions;
+}
 
-// A* Algorithm Ends ----------------------------------------------------------------------------------------------------------------------------
+// Benchmark Ends -------------------------------------------------------------------------------------------------------------------------------
 
 
 
@@ -658,8 +8672,62 @@ private: // data
 const int MAX_CITIES = 20;
 
 enum ENUM_CITIES{Arad=0, Bucharest, Craiova, Drobeta, Eforie, Fagaras, Giurgiu, Hirsova, Iasi, Lugoj, Mehadia, Neamt, Oradea, Pitesti, RimnicuVilcea, Sibiu, Timisoara, Urziceni, Vaslui, Zerind};
-vector<string> CityNames(MAX_CITIES);
-float RomaniaMap[MAX_CITIES][MAX_CITIES];
+const char *RomaniaCityNames[MAX_CITIES] = { "Arad", "Bucharest", "Craiova", "Drobeta", "Eforie", "Fagaras", "Giurgiu", "Hirsova", "Iasi", "Lugoj", "Mehadia", "Neamt", "Oradea", "Pitesti", "RimnicuVilcea", "Sibiu", "Timisoara", "Urziceni", "Vaslui", "Zerind" };
+vector<string> CityNames(RomaniaCityNames, RomaniaCityNames + MAX_CITIES);
+// Roads of Romania, one entry per direction of travel
+const CSREdge RomaniaRoads[] =
+{
+  { Arad, Sibiu, 140 },
+  { Arad, Zerind, 75 },
+  { Arad, Timisoara, 118 },
+  { Bucharest, Giurgiu, 90 },
+  { Bucharest, Urziceni, 85 },
+  { Bucharest, Fagaras, 211 },
+  { Bucharest, Pitesti, 101 },
+  { Craiova, Drobeta, 120 },
+  { Craiova, RimnicuVilcea, 146 },
+  { Craiova, Pitesti, 138 },
+  { Drobeta, Craiova, 120 },
+  { Drobeta, Mehadia, 75 },
+  { Eforie, Hirsova, 75 },
+  { Fagaras, Bucharest, 211 },
+  { Fagaras, Sibiu, 99 },
+  { Giurgiu, Bucharest, 90 },
+  { Hirsova, Eforie, 86 },
+  { Hirsova, Urziceni, 98 },
+  { Iasi, Vaslui, 92 },
+  { Iasi, Neamt, 87 },
+  { Lugoj, Timisoara, 111 },
+  { Lugoj, Mehadia, 70 },
+  { Mehadia, Lugoj, 70 },
+  { Mehadia, Drobeta, 75 },
+  { Neamt, Iasi, 87 },
+  { Oradea, Zerind, 71 },
+  { Oradea, Sibiu, 151 },
+  { Pitesti, Bucharest, 101 },
+  { Pitesti, RimnicuVilcea, 97 },
+  { Pitesti, Craiova, 138 },
+  { RimnicuVilcea, Pitesti, 97 },
+  { RimnicuVilcea, Craiova, 146 },
+  { RimnicuVilcea, Sibiu, 80 },
+  { Sibiu, RimnicuVilcea, 80 },
+  { Sibiu, Fagaras, 99 },
+  { Sibiu, Oradea, 151 },
+  { Sibiu, Arad, 140 },
+  { Timisoara, Arad, 118 },
+  { Timisoara, Lugoj, 111 },
+  { Urziceni, Bucharest, 85 },
+  { Urziceni, Hirsova, 98 },
+  { Urziceni, Vaslui, 142 },
+  { Vaslui, Urziceni, 142 },
+  { Vaslui, Iasi, 92 },
+  { Zerind, Arad, 75 },
+  { Zerind, Oradea, 71 },
+};
+const int NUM_ROADS = sizeof(RomaniaRoads) / sizeof(RomaniaRoads[0]);
+
+CSRGraph RomaniaGraph;
+LandmarkTable RomaniaLandmarks;
 
 class PathSearchNode
 {
@@ -672,9 +8740,10 @@ public:
 
     float GoalDistanceEstimate( PathSearchNode &nodeGoal );
 	bool IsGoal( PathSearchNode &nodeGoal );
-	bool GetSuccessors( AStarSearch<PathSearchNode> *astarsearch, PathSearchNode *parent_node );
+	template <class AStarSearchType> bool GetSuccessors( AStarSearchType *astarsearch, PathSearchNode *parent_node );
 	float GetCost( PathSearchNode &successor );
 	bool IsSameState( PathSearchNode &rhs );
+	size_t Hash();
 
 	void PrintNodeInfo();
 };
@@ -686,10 +8755,19 @@ bool PathSearchNode::IsSameState( PathSearchNode &rhs )
   return(false);
 }
 
-// Euclidean distance between "this" node city and Bucharest
+// hash of "this" node for the state index, equal cities hash equal
+size_t PathSearchNode::Hash()
+{
+  return (size_t)city;
+}
+
+// Euclidean distance between "this" node city and Bucharest, the heuristic from the book. The book only gives
+// distances to Bucharest, so for any other goal the landmark estimate is used instead.
 float PathSearchNode::GoalDistanceEstimate( PathSearchNode &nodeGoal )
 {
-  // goal is always Bucharest!
+  if( nodeGoal.city != Bucharest )
+    return RomaniaLandmarks.Estimate( city, nodeGoal.city );
+
   switch(city)
   {
     case Arad: return 366; break;
@@ -720,19 +8798,18 @@ float PathSearchNode::GoalDistanceEstimate( PathSearchNode &nodeGoal )
 // check if "this" node is the goal node
 bool PathSearchNode::IsGoal( PathSearchNode &nodeGoal )
 {
-	if( city == Bucharest ) return(true);
+	if( city == nodeGoal.city ) return(true);
 	return(false);
 }
 
 // generates the successor nodes of "this" node
-bool PathSearchNode::GetSuccessors( AStarSearch<PathSearchNode> *astarsearch, PathSearchNode *parent_node )
+template <class AStarSearchType> bool PathSearchNode::GetSuccessors( AStarSearchType *astarsearch, PathSearchNode *parent_node )
 {
   PathSearchNode NewNode;
-  for(int c=0; c<MAX_CITIES; c++)
+  for(unsigned int e=RomaniaGraph.EdgesBegin(city); e<RomaniaGraph.EdgesEnd(city); e++)
   {
-    if(RomaniaMap[city][c] < 0) continue;
-    NewNode = PathSearchNode((ENUM_CITIES)c);
-    astarsearch->AddSuccessor( NewNode );
+    NewNode = PathSearchNode((ENUM_CITIES)RomaniaGraph.GetEdgeTarget(e));
+    if( !astarsearch->AddSuccessor( NewNode ) ) return false; // out of node memory
   }
 	return true;
 }
@@ -740,7 +8817,7 @@ bool PathSearchNode::GetSuccessors( AStarSearch<PathSearchNode> *astarsearch, Pa
 // the cost of going from "this" node to the "successor" node
 float PathSearchNode::GetCost( PathSearchNode &successor )
 {
-	return RomaniaMap[city][successor.city];
+	return RomaniaGraph.GetEdgeWeight(city, successor.city);
 }
 
 // prints out information about the node
@@ -749,86 +8826,582 @@ void PathSearchNode::PrintNodeInfo()
 	cout << CityNames[city];
 }
 
-int main( )
+// The search used by the program, with cities looked up through the hash index and each expansion printed
+typedef AStarSearch<PathSearchNode, AStarHashIndex, AStarBinaryHeap, AStarPrintTrace> PathSearch;
+
+// Finds a node by number, or by name if the graph has names
+bool FindGraphNode( const CSRGraph &graph, const char *text, unsigned int &node )
+{
+  char *end;
+  unsigned long n = strtoul( text, &end, 10 );
+  if( *text && *end == '\0' && n < graph.GetNodeCount() ) { node = (unsigned int)n; return true; }
+  if( !graph.HasNames() ) return false;
+  for( node = 0; node < graph.GetNodeCount(); node++ )
+    if( graph.GetName( node ) == text ) return true;
+  return false;
+}
+
+// Searches a graph file for the shortest route between two of its nodes
+int RouteOnGraphFile( const char *path, const char *from, const char *to, unsigned int landmarks )
+{
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+  MappedGraphFile file;
+  if( !file.Open( path ) )
+  {
+    cerr << "Can't open graph file " << path << endl;
+    return 1;
+  }
+
+  CSRGraph &graph = file.GetGraph();
+  cout << "Mapped " << graph.GetNodeCount() << " nodes and " << graph.GetEdgeCount() << " edges in "
+       << chrono::duration<double, milli>( chrono::steady_clock::now() - started ).count() << " ms\n";
+
+  // Landmarks only pay off over many queries, but they show how much tighter the estimates get
+  LandmarkTable table;
+  if( landmarks )
+  {
+    started = chrono::steady_clock::now();
+    table.Build( graph, landmarks );
+    graph.SetLandmarks( &table );
+    cout << "Built " << table.GetLandmarkCount() << " landmarks in "
+         << chrono::duration<double, milli>( chrono::steady_clock::now() - started ).count() << " ms\n";
+  }
+
+  unsigned int start, goal;
+  if( !FindGraphNode( graph, from, start ) || !FindGraphNode( graph, to, goal ) )
+  {
+    cerr << "Unknown node " << from << " or " << to << endl;
+    return 1;
+  }
+
+  AStarSearch<CSRGraphNode, AStarHashIndex> astarsearch;
+  CSRGraphNode nodeStart( &graph, start ), nodeEnd( &graph, goal );
+  astarsearch.SetStartAndGoalStates( nodeStart, nodeEnd );
+  AStarSearch<CSRGraphNode, AStarHashIndex>::SearchResult result = astarsearch.Search();
+
+  if( result.state != AStarSearch<CSRGraphNode, AStarHashIndex>::SEARCH_STATE_SUCCEEDED )
+  {
+    cout << "Search terminated. Did not find goal state\n";
+    return 1;
+  }
+
+  for( size_t i = 0; i < result.path.size(); i++ )
+  {
+    if( i ) cout << " -> ";
+    result.path[i].PrintNodeInfo();
+  }
+  cout << "\n\nCost: " << result.cost << "  Nodes expanded: " << result.nodesExpanded << endl;
+#ifdef ASTAR_COLLECT_STATS
+  const AStarSearchStats &stats = astarsearch.GetStats();
+  cout << "Successors: " << stats.successorsGenerated << " generated, " << stats.prunedByOpen << " pruned by open, "
+       << stats.prunedByClosed << " pruned by closed, " << stats.reopened << " reopened\n"
+       << "Heap: " << stats.heapPushes << " pushes, " << stats.heapPops << " pops, " << stats.heapUpdates << " updates\n"
+       << "Peak open " << stats.peakOpen << ", peak closed " << stats.peakClosed << endl;
+#endif
+#ifdef ASTAR_COLLECT_TIMING
+  cout << "Generating successors " << stats.successorNanoseconds / 1000 << " us, heap " << stats.heapNanoseconds / 1000 << " us" << endl;
+#endif
+  astarsearch.FreeSolutionNodes();
+  return 0;
+}
+
+// Builds a contraction hierarchy for a graph file and saves it
+int ContractGraphFile( const char *path, const char *hierarchyPath )
+{
+  MappedGraphFile file;
+  if( !file.Open( path ) )
+  {
+    cerr << "Can't open graph file " << path << endl;
+    return 1;
+  }
+
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+  ContractionHierarchy hierarchy;
+  hierarchy.Build( file.GetGraph() );
+  cout << "Contracted " << hierarchy.GetNodeCount() << " nodes in "
+       << chrono::duration<double, milli>( chrono::steady_clock::now() - started ).count() << " ms, added "
+       << hierarchy.GetShortcutCount() << " shortcuts\n";
+
+  if( !hierarchy.Save( hierarchyPath ) )
+  {
+    cerr << "Can't write hierarchy file " << hierarchyPath << endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Answers a route query from a saved contraction hierarchy, printing the route the way RouteOnGraphFile does
+int RouteOnHierarchy( const char *path, const char *hierarchyPath, const char *from, const char *to )
+{
+  MappedGraphFile file;
+  if( !file.Open( path ) )
+  {
+    cerr << "Can't open graph file " << path << endl;
+    return 1;
+  }
+
+  const CSRGraph &graph = file.GetGraph();
+  ContractionHierarchy hierarchy;
+  if( !hierarchy.Load( hierarchyPath ) || hierarchy.GetNodeCount() != graph.GetNodeCount() )
+  {
+    cerr << "Can't read hierarchy file " << hierarchyPath << " for " << path << endl;
+    return 1;
+  }
+
+  unsigned int start, goal;
+  if( !FindGraphNode( graph, from, start ) || !FindGraphNode( graph, to, goal ) )
+  {
+    cerr << "Unknown node " << from << " or " << to << endl;
+    return 1;
+  }
+
+  vector<unsigned int> route;
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+  float cost = hierarchy.Query( start, goal, route );
+  double micros = chrono::duration<double, micro>( chrono::steady_clock::now() - started ).count();
+
+  if( cost == FLT_MAX )
+  {
+    cout << "Search terminated. Did not find goal state\n";
+    return 1;
+  }
+
+  for( size_t i = 0; i < route.size(); i++ )
+  {
+    if( i ) cout << " -> ";
+    CSRGraphNode( &graph, route[i] ).PrintNodeInfo();
+  }
+  cout << "\n\nCost: " << cost << "  Nodes settled: " << hierarchy.GetSettledCount() << "  Query time: " << micros << " us" << endl;
+  return 0;
+}
+
+// Splits a comma separated list of node numbers or names
+bool FindGraphNodes( const CSRGraph &graph, const char *text, vector<unsigned int> &nodes )
+{
+  stringstream list( text );
+  string item;
+  while( getline( list, item, ',' ) )
+  {
+    unsigned int node;
+    if( !FindGraphNode( graph, item.c_str(), node ) )
+    {
+      cerr << "Unknown node " << item << endl;
+      return false;
+    }
+    nodes.push_back( node );
+  }
+  return !nodes.empty();
+}
+
+// Prints the table of route costs from every one of a list of nodes to every one of another
+int RouteMatrixOnGraphFile( const char *path, const char *from, const char *to )
+{
+  MappedGraphFile file;
+  if( !file.Open( path ) )
+  {
+    cerr << "Can't open graph file " << path << endl;
+    return 1;
+  }
+
+  CSRGraph &graph = file.GetGraph();
+  vector<unsigned int> sources, targets;
+  if( !FindGraphNodes( graph, from, sources ) || !FindGraphNodes( graph, to, targets ) )
+  {
+    return 1;
+  }
+  if( targets.size() < sources.size() )
+  {
+    graph.BuildReverse(); // the searches run backwards from the targets
+  }
+
+  CSRDistanceMatrix matrix;
+  vector<float> costs;
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+  matrix.Compute( graph, sources, targets, costs );
+  double millis = chrono::duration<double, milli>( chrono::steady_clock::now() - started ).count();
+
+  for( size_t j = 0; j < targets.size(); j++ )
+  {
+    cout << "\t";
+    CSRGraphNode( &graph, targets[j] ).PrintNodeInfo();
+  }
+  cout << "\n";
+  for( size_t i = 0; i < sources.size(); i++ )
+  {
+    CSRGraphNode( &graph, sources[i] ).PrintNodeInfo();
+    for( size_t j = 0; j < targets.size(); j++ )
+    {
+      float cost = costs[i * targets.size() + j];
+      cout << "\t";
+      if( cost == FLT_MAX ) cout << "-"; else cout << cost;
+    }
+    cout << "\n";
+  }
+  cout << "\nNodes settled: " << matrix.GetSettledCount() << "  Threads: " << matrix.GetThreadCount() << "  Time: " << millis << " ms" << endl;
+  return 0;
+}
+
+// Searches a grid map with jump point search, and with plain A* to show how many more cells that expands
+int RouteOnGridMap( const char *path, int fromX, int fromY, int toX, int toY )
+{
+  GridMap map;
+  if( !map.Load( path ) )
+  {
+    cerr << "Can't read grid map " << path << endl;
+    return 1;
+  }
+
+  GridCell start( fromX, fromY ), goal( toX, toY );
+  AStarJPSSearch<> jps( map );
+  chrono::steady_clock::time_point started = chrono::steady_clock::now();
+  jps.SetStartAndGoalStates( start, goal );
+  AStarJPSSearch<>::SearchResult result = jps.Search();
+  double micros = chrono::duration<double, micro>( chrono::steady_clock::now() - started ).count();
+
+  if( result.state != AStarJPSSearch<>::SEARCH_STATE_SUCCEEDED )
+  {
+    cout << "Search terminated. Did not find goal state\n";
+    return 1;
+  }
+
+  for( size_t i = 0; i < result.path.size(); i++ )
+  {
+    if( i ) cout << " -> ";
+    result.path[i].PrintNodeInfo();
+  }
+
+  AStarSearch<GridMapNode, AStarHashIndex> astar;
+  GridMapNode nodeStart( &map, fromX, fromY ), nodeEnd( &map, toX, toY );
+  astar.SetStartAndGoalStates( nodeStart, nodeEnd );
+  AStarSearch<GridMapNode, AStarHashIndex>::SearchResult plain = astar.Search();
+  if( plain.state == AStarSearch<GridMapNode, AStarHashIndex>::SEARCH_STATE_SUCCEEDED )
+  {
+    astar.FreeSolutionNodes();
+  }
+
+  cout << "\n\nCost: " << result.cost << "  Nodes expanded: " << result.nodesExpanded << " (A*: " << plain.nodesExpanded << ")  Search time: " << micros << " us" << endl;
+  jps.FreeSolutionNodes();
+  return 0;
+}
+
+// Runs the benchmark engines over generated graphs, writes the results as comma separated values and, given a
+// baseline written by an earlier run, reports anything that got worse
+int RunBenchmarks( const string &kind, unsigned int size, unsigned int queries, const char *baselinePath )
+{
+  vector<string> kinds;
+  if( kind == "all" )
+  {
+    kinds.push_back( "grid" );
+    kinds.push_back( "geometric" );
+    kinds.push_back( "road" );
+  }
+  else
+  {
+    kinds.push_back( kind );
+  }
+
+  vector<BenchmarkResult> baseline, results;
+  if( baselinePath && !ReadBenchmarkResults( baselinePath, baseline ) )
+  {
+    cerr << "Can't read baseline " << baselinePath << endl;
+    return 1;
+  }
+
+  cout << BenchmarkColumns << "\n";
+
+  for( size_t k = 0; k < kinds.size(); k++ )
+  {
+    CSRGraph graph;
+    if( size == 0 || !BuildBenchmarkGraph( kinds[k], size, 1, graph ) )
+    {
+      cerr << "Unknown graph kind " << kinds[k] << " or size " << size << endl;
+      return 1;
+    }
+
+    vector< pair<unsigned int, unsigned int> > set;
+    BuildBenchmarkQueries( graph, queries, 1, set );
+
+    BenchmarkResult result;
+    result.graph = kinds[k];
+    result.size = size;
+
+    RunBenchmark< AStarSearch<CSRGraphNode, AStarHashIndex> >( "astar", graph, set, result );
+    results.push_back( result );
+    RunBenchmark< AStarSearch<CSRGraphNode, AStarHashIndex, AStarQuaternaryHeap> >( "astar-dary4", graph, set, result );
+    results.push_back( result );
+    RunBenchmark< AStarCompactSearch<CSRGraphNode, AStarVertexNodes> >( "compact", graph, set, result );
+    results.push_back( result );
+    RunBenchmark< AStarSearch<CSRGraphNode, AStarHashIndex, AStarAutoOpenList, AStarNoTrace, float, AStarZeroEstimate> >( "dijkstra", graph, set, result );
+    results.push_back( result );
+
+    for( size_t i = results.size() - 4; i < results.size(); i++ )
+    {
+      WriteBenchmarkResult( cout, results[i] );
+    }
+  }
+
+  if( baselinePath && CompareBenchmarkResults( baseline, results, 0.1, cerr ) )
+  {
+    return 1;
+  }
+  return 0;
+}
+
+// Checks AStarLPASearch's repairs against Dijkstra run from scratch. Each round builds a small random graph with 0 cost
+// and parallel edges, plans one route, then changes a few edge costs at a time and compares the repaired route.
+int CheckReplanning( unsigned int nodes, unsigned int rounds )
+{
+  typedef AStarLPASearch<CSRGraphNode> ReplanSearch;
+
+  const unsigned int UpdatesPerRound = 30;
+
+  if( nodes == 0 )
+  {
+    cerr << "Need at least one node" << endl;
+    return 1;
+  }
+
+  unsigned int checks = 0, failures = 0;
+
+  for( unsigned int round = 0; round < rounds; round++ )
+  {
+    BenchmarkRandom random( round + 1 );
+
+    // costs 0 to 3, with one edge in five doubled so that two edges join the same nodes
+    vector<CSREdge> edges;
+    for( unsigned int i = 0; i < nodes * 3; i++ )
+    {
+      CSREdge edge;
+      edge.from = random.Below( nodes );
+      edge.to = random.Below( nodes );
+      edge.weight = (float)random.Below( 4 );
+      edges.push_back( edge );
+      if( random.Below( 5 ) == 0 )
+      {
+        edges.push_back( edge );
+      }
+    }
+
+    CSRGraph graph;
+    graph.Build( nodes, edges );
+    graph.BuildReverse();
+
+    CSRGraphNode start( &graph, random.Below( nodes ) );
+    CSRGraphNode goal( &graph, random.Below( nodes ) );
+
+    ReplanSearch search;
+    search.SetStartAndGoalStates( start, goal );
+    search.Search();
+
+    for( unsigned int update = 0; update < UpdatesPerRound; update++ )
+    {
+      for( unsigned int changes = 1 + random.Below( 3 ); changes > 0; changes-- )
+      {
+        CSRGraphNode from( &graph, random.Below( nodes ) );
+        unsigned int begin = graph.EdgesBegin( from.m_Node ), end = graph.EdgesEnd( from.m_Node );
+        if( begin == end )
+        {
+          continue;
+        }
+
+        unsigned int edge = begin + random.Below( end - begin );
+        graph.SetEdgeWeight( edge, (float)random.Below( 5 ) );
+
+        CSRGraphNode to( &graph, graph.GetEdgeTarget( edge ) );
+        search.UpdateEdge( from, to );
+      }
+
+      ReplanSearch::SearchResult result = search.Search();
+
+      vector<float> distance;
+      CSRGraphDijkstra( graph, start.m_Node, false, distance );
+
+      // the route has to cost what Dijkstra says, and add up to that along its edges
+      float cost = result.state == ReplanSearch::SEARCH_STATE_SUCCEEDED ? result.cost : FLT_MAX;
+      float walked = result.state == ReplanSearch::SEARCH_STATE_SUCCEEDED ? 0.0f : FLT_MAX;
+      for( size_t i = 0; i + 1 < result.path.size(); i++ )
+      {
+        walked += graph.GetEdgeWeight( result.path[i].m_Node, result.path[i + 1].m_Node );
+      }
+
+      checks++;
+      if( cost != distance[goal.m_Node] || walked != cost )
+      {
+        cerr << "Round " << round << " update " << update << ": repaired cost " << cost << ", route adds up to " << walked
+             << ", Dijkstra " << distance[goal.m_Node] << endl;
+        failures++;
+        break;
+      }
+    }
+  }
+
+  cout << checks << " repairs checked, " << failures << " wrong" << endl;
+  return failures ? 1 : 0;
+}
+
+// Prints a check that failed and counts it
+void ReportCheck( const char *what, bool passed, unsigned int &checks, unsigned int &failures )
+{
+  checks++;
+  if( !passed )
+  {
+    cerr << "Failed: " << what << endl;
+    failures++;
+  }
+}
+
+// Checks how the search engines behave across the calls that make up a search's life, on a generated grid graph
+int CheckSearches()
+{
+  typedef AStarSearch<CSRGraphNode, AStarHashIndex> SearchType;
+
+  CSRGraph graph;
+  BuildBenchmarkGraph( "grid", 40, 1, graph );
+  graph.BuildReverse();
+
+  vector< pair<unsigned int, unsigned int> > queries;
+  BuildBenchmarkQueries( graph, 2, 1, queries );
+
+  CSRGraphNode start( &graph, queries[0].first ), goal( &graph, queries[0].second );
+  unsigned int checks = 0, failures = 0;
+
+  // freeing a solution leaves nothing to read, and freeing it again does nothing
+  {
+    SearchType search;
+    search.SetStartAndGoalStates( start, goal );
+    ReportCheck( "search succeeds", search.Search().state == SearchType::SEARCH_STATE_SUCCEEDED, checks, failures );
+
+    search.FreeSolutionNodes();
+    search.FreeSolutionNodes();
+    ReportCheck( "freed solution has no cost", search.GetSolutionCost() == FLT_MAX, checks, failures );
+    ReportCheck( "freed solution has no states", !search.GetSolutionStart() && !search.GetSolutionEnd() && search.GetSolutionLength() == 0, checks, failures );
+    ReportCheck( "freed solution returns every node", search.GetAllocatedNodeCount() == 0, checks, failures );
+  }
+
+  // a bidirectional search started over without freeing the last one searches as if it were new
+  {
+    typedef AStarBidirectionalSearch<CSRGraphNode> BidirectionalType;
+
+    CSRGraphNode otherStart( &graph, queries[1].first ), otherGoal( &graph, queries[1].second );
+    BidirectionalType reused, fresh;
+
+    reused.SetStartAndGoalStates( start, goal );
+    reused.Search();
+    reused.SetStartAndGoalStates( otherStart, otherGoal );
+    BidirectionalType::SearchResult again = reused.Search();
+
+    fresh.SetStartAndGoalStates( otherStart, otherGoal );
+    BidirectionalType::SearchResult once = fresh.Search();
+
+    ReportCheck( "reused bidirectional search finds the same route", again.state == once.state && again.cost == once.cost &&
+                 again.nodesExpanded == once.nodesExpanded, checks, failures );
+    ReportCheck( "reused bidirectional search holds no old nodes", reused.GetAllocatedNodeCount() == fresh.GetAllocatedNodeCount(), checks, failures );
+  }
+
+  // an anytime search in between leaves focal search set, so the focal search after it matches the one before
+  {
+    SearchType search;
+    search.SetSuboptimalBound( 1.5f, true );
+
+    search.SetStartAndGoalStates( start, goal );
+    SearchType::SearchResult before = search.Search();
+    search.FreeSolutionNodes();
+
+    SearchType::SearchResult anytime;
+    search.SetStartAndGoalStates( start, goal );
+    search.SearchAnytime( anytime, 2.0f, 0.5f );
+    search.FreeSolutionNodes();
+
+    search.SetStartAndGoalStates( start, goal );
+    SearchType::SearchResult after = search.Search();
+    search.FreeSolutionNodes();
+
+    ReportCheck( "anytime search finds the best route", anytime.state == SearchType::SEARCH_STATE_SUCCEEDED && anytime.bound == 1.0f, checks, failures );
+    ReportCheck( "focal search survives an anytime search", after.state == before.state && after.cost == before.cost &&
+                 after.nodesExpanded == before.nodesExpanded, checks, failures );
+  }
+
+  cout << checks << " checks, " << failures << " failed" << endl;
+  return failures ? 1 : 0;
+}
+
+int main( int argc, char *argv[] )
 {
   // creating map of Romania
-  for(int i=0; i<MAX_CITIES; i++)
-    for(int j=0; j<MAX_CITIES; j++)
-      RomaniaMap[i][j]=-1.0;
-
-  RomaniaMap[Arad][Sibiu]=140;
-  RomaniaMap[Arad][Zerind]=75;
-  RomaniaMap[Arad][Timisoara]=118;
-  RomaniaMap[Bucharest][Giurgiu]=90;
-  RomaniaMap[Bucharest][Urziceni]=85;
-  RomaniaMap[Bucharest][Fagaras]=211;
-  RomaniaMap[Bucharest][Pitesti]=101;
-  RomaniaMap[Craiova][Drobeta]=120;
-  RomaniaMap[Craiova][RimnicuVilcea]=146;
-  RomaniaMap[Craiova][Pitesti]=138;
-  RomaniaMap[Drobeta][Craiova]=120;
-  RomaniaMap[Drobeta][Mehadia]=75;
-  RomaniaMap[Eforie][Hirsova]=75;
-  RomaniaMap[Fagaras][Bucharest]=211;
-  RomaniaMap[Fagaras][Sibiu]=99;
-  RomaniaMap[Giurgiu][Bucharest]=90;
-  RomaniaMap[Hirsova][Eforie]=86;
-  RomaniaMap[Hirsova][Urziceni]=98;
-  RomaniaMap[Iasi][Vaslui]=92;
-  RomaniaMap[Iasi][Neamt]=87;
-  RomaniaMap[Lugoj][Timisoara]=111;
-  RomaniaMap[Lugoj][Mehadia]=70;
-  RomaniaMap[Mehadia][Lugoj]=70;
-  RomaniaMap[Mehadia][Drobeta]=75;
-  RomaniaMap[Neamt][Iasi]=87;
-  RomaniaMap[Oradea][Zerind]=71;
-  RomaniaMap[Oradea][Sibiu]=151;
-  RomaniaMap[Pitesti][Bucharest]=101;
-  RomaniaMap[Pitesti][RimnicuVilcea]=97;
-  RomaniaMap[Pitesti][Craiova]=138;
-  RomaniaMap[RimnicuVilcea][Pitesti]=97;
-  RomaniaMap[RimnicuVilcea][Craiova]=146;
-  RomaniaMap[RimnicuVilcea][Sibiu]=80;
-  RomaniaMap[Sibiu][RimnicuVilcea]=80;
-  RomaniaMap[Sibiu][Fagaras]=99;
-  RomaniaMap[Sibiu][Oradea]=151;
-  RomaniaMap[Sibiu][Arad]=140;
-  RomaniaMap[Timisoara][Arad]=118;
-  RomaniaMap[Timisoara][Lugoj]=111;
-  RomaniaMap[Urziceni][Bucharest]=85;
-  RomaniaMap[Urziceni][Hirsova]=98;
-  RomaniaMap[Urziceni][Vaslui]=142;
-  RomaniaMap[Vaslui][Urziceni]=142;
-  RomaniaMap[Vaslui][Iasi]=92;
-  RomaniaMap[Zerind][Arad]=75;
-  RomaniaMap[Zerind][Oradea]=71;
-
-  // City names
-  CityNames[Arad].assign("Arad");
-  CityNames[Bucharest].assign("Bucharest");
-  CityNames[Craiova].assign("Craiova");
-  CityNames[Drobeta].assign("Drobeta");
-  CityNames[Eforie].assign("Eforie");
-  CityNames[Fagaras].assign("Fagaras");
-  CityNames[Giurgiu].assign("Giurgiu");
-  CityNames[Hirsova].assign("Hirsova");
-  CityNames[Iasi].assign("Iasi");
-  CityNames[Lugoj].assign("Lugoj");
-  CityNames[Mehadia].assign("Mehadia");
-  CityNames[Neamt].assign("Neamt");
-  CityNames[Oradea].assign("Oradea");
-  CityNames[Pitesti].assign("Pitesti");
-  CityNames[RimnicuVilcea].assign("RimnicuVilcea");
-  CityNames[Sibiu].assign("Sibiu");
-  CityNames[Timisoara].assign("Timisoara");
-  CityNames[Urziceni].assign("Urziceni");
-  CityNames[Vaslui].assign("Vaslui");
-  CityNames[Zerind].assign("Zerind");
+  RomaniaGraph.Build( MAX_CITIES, vector<CSREdge>( RomaniaRoads, RomaniaRoads + NUM_ROADS ) );
+  RomaniaGraph.SetNames( CityNames );
+  RomaniaLandmarks.Build( RomaniaGraph, 4 );
+
+  // Graph file commands, otherwise run the Romania demo
+  if( argc == 4 && string( argv[1] ) == "convert" )
+  {
+    string error;
+    if( !ConvertEdgeListToGraphFile( argv[2], argv[3], error ) )
+    {
+      cerr << error << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if( argc == 3 && string( argv[1] ) == "export" )
+  {
+    return WriteGraphFile( argv[2], RomaniaGraph ) ? 0 : 1;
+  }
+  if( ( argc == 5 || argc == 6 ) && string( argv[1] ) == "route" )
+  {
+    return RouteOnGraphFile( argv[2], argv[3], argv[4], argc == 6 ? (unsigned int)atoi( argv[5] ) : 0 );
+  }
+  if( argc == 4 && string( argv[1] ) == "contract" )
+  {
+    return ContractGraphFile( argv[2], argv[3] );
+  }
+  if( argc == 6 && string( argv[1] ) == "chroute" )
+  {
+    return RouteOnHierarchy( argv[2], argv[3], argv[4], argv[5] );
+  }
+  if( argc == 5 && string( argv[1] ) == "matrix" )
+  {
+    return RouteMatrixOnGraphFile( argv[2], argv[3], argv[4] );
+  }
+  if( argc == 7 && string( argv[1] ) == "gridroute" )
+  {
+    return RouteOnGridMap( argv[2], atoi( argv[3] ), atoi( argv[4] ), atoi( argv[5] ), atoi( argv[6] ) );
+  }
+  if( ( argc == 5 || argc == 6 ) && string( argv[1] ) == "bench" )
+  {
+    return RunBenchmarks( argv[2], (unsigned int)atoi( argv[3] ), (unsigned int)atoi( argv[4] ), argc == 6 ? argv[5] : NULL );
+  }
+  if( argc == 4 && string( argv[1] ) == "replancheck" )
+  {
+    return CheckReplanning( (unsigned int)atoi( argv[2] ), (unsigned int)atoi( argv[3] ) );
+  }
+  if( argc == 2 && string( argv[1] ) == "searchcheck" )
+  {
+    return CheckSearches();
+  }
+  if( argc != 1 )
+  {
+    cerr << "usage: " << argv[0] << "\t\t\t\truns the Romania demo\n"
+         << "       " << argv[0] << " convert <edges.txt> <graph file>\tconverts a text edge list\n"
+         << "       " << argv[0] << " export <graph file>\t\twrites the Romania map\n"
+         << "       " << argv[0] << " route <graph file> <from> <to> [landmarks]\tsearches a graph file\n"
+         << "       " << argv[0] << " contract <graph file> <hierarchy file>\tbuilds a contraction hierarchy\n"
+         << "       " << argv[0] << " chroute <graph file> <hierarchy file> <from> <to>\tqueries a contraction hierarchy\n"
+         << "       " << argv[0] << " matrix <graph file> <from,...> <to,...>\ttabulates route costs\n"
+         << "       " << argv[0] << " gridroute <map file> <x> <y> <x> <y>\tsearches a grid map\n"
+         << "       " << argv[0] << " bench <grid|geometric|road|all> <size> <queries> [baseline]\ttimes the searches\n"
+         << "       " << argv[0] << " replancheck <nodes> <rounds>\t\tchecks incremental replanning against Dijkstra\n"
+         << "       " << argv[0] << " searchcheck\t\t\t\tchecks the search engines' life cycle\n";
+    return 1;
+  }
+
 
   ENUM_CITIES initCity = Arad; // Choose your start state.
+  ENUM_CITIES goalCity = Bucharest; // Choose your goal state.
 
     // An instance of A* search class
-	AStarSearch<PathSearchNode> astarsearch;
+	PathSearch astarsearch;
 
 	unsigned int SearchCount = 0;
 	const unsigned int NumSearches = 1;
@@ -839,9 +9412,9 @@ int main( )
 		PathSearchNode nodeStart;
 		nodeStart.city = initCity;
 
-		// Define the goal state, always Bucharest!
+		// Define the goal state
 		PathSearchNode nodeEnd;
-		nodeEnd.city = Bucharest;
+		nodeEnd.city = goalCity;
 
 		// Set Start and goal states
 		astarsearch.SetStartAndGoalStates( nodeStart, nodeEnd );
@@ -896,9 +9469,9 @@ int main( )
 
 
 		}
-		while( SearchState == AStarSearch<PathSearchNode>::SEARCH_STATE_SEARCHING );
+		while( SearchState == PathSearch::SEARCH_STATE_SEARCHING );
 
-		if( SearchState == AStarSearch<PathSearchNode>::SEARCH_STATE_SUCCEEDED )
+		if( SearchState == PathSearch::SEARCH_STATE_SUCCEEDED )
 		{
 			cout << "Search found the goal state.\n\n";
       PathSearchNode *node = astarsearch.GetSolutionStart();
@@ -917,7 +9490,7 @@ int main( )
       // Once we're done with the solution we can free the nodes up
 			astarsearch.FreeSolutionNodes();
 		}
-		else if( SearchState == AStarSearch<PathSearchNode>::SEARCH_STATE_FAILED )
+		else if( SearchState == PathSearch::SEARCH_STATE_FAILED )
 		{
 			cout << "Search terminated. Did not find goal state\n";
 		}